@@ -0,0 +1,3848 @@
+/*
+ * (c) 2017 the mullican group
+ * kevin mullican
+ *
+ * libsketcher.cpp
+ *
+ * the conversion itself: extract 'nodes' from a collada file exported
+ * from sketchup, then write the nodes and beams to a beamng.drive jbeam
+ * file
+ */
+
+#include <vector>
+#include <map>
+#include <queue>
+#include <deque>
+#include <iterator>
+#include <functional>
+#include <new>
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include <pthread.h>
+
+#include <time.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+
+#include <linux/perf_event.h>
+
+#include "tinyxml2.h"
+#include "sketcher.h"
+
+using namespace std;
+using namespace tinyxml2;
+
+// printf at or above a verbosity. a message that is off costs the one
+// compare, its arguments are never evaluated or formatted
+#define LOG(verbosity, level, ...) \
+  do { if ((verbosity) >= (level)) printf (__VA_ARGS__); } while (0)
+
+bool Mesh::reserve (int max_nodes, int max_tris) {
+  size_t n = max_nodes;
+  size_t t = max_tris;
+
+  // every triangle edge is a beam, and each pair of triangles across
+  // an edge can add a cross beam, which is at most one per edge
+  // unless more than two triangles meet there
+  size_t b = 6 * t;
+
+  size_t bytes = n * sizeof (vect)
+               + t * 3 * sizeof (unsigned int)
+               + t * sizeof (triangle)
+               + t * 3 * sizeof (edge)
+               + b * sizeof (edge)
+               + t * 3 * sizeof (unsigned int)
+               + b * sizeof (unsigned int)
+               + n * sizeof (int)
+               + 8 * 16;
+  if (! mem . reserve (bytes)) return false;
+
+  nodes = mem . take <vect> (n);
+  tridx = mem . take <unsigned int> (t * 3);
+  triangles = mem . take <triangle> (t);
+  edges = mem . take <edge> (t * 3);
+  beams = mem . take <edge> (b);
+  collision = mem . take <unsigned int> (t * 3);
+  scratch = mem . take <unsigned int> (b);
+  groups = mem . take <int> (n);
+  group_count = 0;
+  node_cap = max_nodes;
+  tri_cap = max_tris;
+  beam_cap = (int)b;
+  node_count = tri_count = edge_count = beam_count = collision_count = 0;
+  return true;
+}
+
+double tracer::now () {
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+void tracer::add (const span &s) {
+  pthread_mutex_lock (&lock);
+  spans . push_back (s);
+  spans . back () . thread = syscall (SYS_gettid);
+  pthread_mutex_unlock (&lock);
+}
+
+// complete events, one per span, with the file as an argument so
+// perfetto can filter on it
+bool tracer::write (const char *path) {
+  FILE *fp = fopen (path, "w");
+  if (! fp) return false;
+
+  pthread_mutex_lock (&lock);
+  int pid = getpid ();
+  fprintf (fp, "{\"traceEvents\":[\n");
+  for (size_t i = 0; i < spans . size (); ++i) {
+    const span &s = spans [i];
+    string file;
+    for (size_t j = 0; j < s.file . size (); ++j) {
+      char c = s.file [j];
+      if (c == '"' || c == '\\') file += '\\';
+      if ((unsigned char)c >= 0x20) file += c;
+    }
+    fprintf (fp, "{\"name\":\"%s\",\"cat\":\"sketcher\",\"ph\":\"X\","
+                 "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%ld,"
+                 "\"args\":{\"file\":\"%s\"",
+                 s.name, s.start, s.length, pid, s.thread, file . c_str ());
+    if (memoryStats::enabled ())
+      fprintf (fp, ",\"allocations\":%lu,\"bytes\":%zu,\"peak_bytes\":%zu,"
+                   "\"max_rss_kb\":%ld",
+                   s.allocations, s.bytes, s.peak, s.max_rss_kb);
+    if (s.counted)
+      fprintf (fp, ",\"cycles\":%llu,\"instructions\":%llu,"
+                   "\"cache_references\":%llu,\"cache_misses\":%llu,"
+                   "\"branches\":%llu,\"branch_misses\":%llu",
+                   s.counts [perfCounters::CYCLES],
+                   s.counts [perfCounters::INSTRUCTIONS],
+                   s.counts [perfCounters::CACHE_REFERENCES],
+                   s.counts [perfCounters::CACHE_MISSES],
+                   s.counts [perfCounters::BRANCHES],
+                   s.counts [perfCounters::BRANCH_MISSES]);
+    fprintf (fp, "}}%s\n", i + 1 < spans . size () ? "," : "");
+  }
+  fprintf (fp, "],\"displayTimeUnit\":\"ms\"}\n");
+  pthread_mutex_unlock (&lock);
+
+  return fclose (fp) == 0;
+}
+
+void tracer::printMemory (FILE *fp) {
+  if (! memoryStats::enabled ()) return;
+
+  // stages in the order they first ran
+  vector <span> total;
+  pthread_mutex_lock (&lock);
+  for (size_t i = 0; i < spans . size (); ++i) {
+    const span &s = spans [i];
+    size_t j = 0;
+    while (j < total . size () && strcmp (total [j] . name, s.name)) ++j;
+    if (j == total . size ()) {
+      total . push_back (s);
+      continue;
+    }
+    total [j] . allocations += s.allocations;
+    total [j] . bytes += s.bytes;
+    total [j] . peak = max (total [j] . peak, s.peak);
+    total [j] . max_rss_kb = max (total [j] . max_rss_kb, s.max_rss_kb);
+  }
+  pthread_mutex_unlock (&lock);
+
+  fprintf (fp, "%-10s %12s %14s %14s %12s\n",
+               "stage", "allocations", "bytes", "peak bytes", "max rss kb");
+  for (size_t j = 0; j < total . size (); ++j)
+    fprintf (fp, "%-10s %12lu %14zu %14zu %12ld\n",
+                 total [j] . name, total [j] . allocations, total [j] . bytes,
+                 total [j] . peak, total [j] . max_rss_kb);
+}
+
+// tasks spawned together, and how many of them are still to finish
+struct taskGroup {
+  int pending;
+  taskGroup() : pending (0) {}
+};
+
+// a work stealing pool. each thread keeps its own queue, running the
+// newest of its own tasks and, when it has none, taking the oldest of
+// another's. a task may spawn more and wait for them, and runs queued
+// tasks while it waits, so a big file's tokenizing, surfaces and
+// formatting spread over the threads that small files left idle.
+// the tasks spawned from outside any task, the files of a batch, wait
+// in a queue of their own: a thread waiting inside a task only runs
+// pieces, so a whole new file never holds up the one it is finishing.
+// the pieces of a task run by a thread from outside the pool go to a
+// queue the pool's threads steal from like any other.
+struct taskPool {
+  struct task {
+    void (*run)(void *arg);
+    void *arg;
+    taskGroup *group;
+  };
+  struct queue {
+    deque <task> tasks;
+    pthread_mutex_t lock;
+  };
+
+  vector <pthread_t> threads;
+  vector <queue> queues;        // one per thread, the outsiders' pieces, the files
+  int queued;                   // pieces in any queue
+  int queued_outside;           // and files
+  bool stopping;
+  pthread_mutex_t idle_lock;
+  pthread_cond_t idle;
+
+  // threads besides the callers of wait, which also run tasks
+  taskPool(int count);
+  ~taskPool();
+  void spawn(taskGroup &group, void (*run)(void *), void *arg);
+  void wait(taskGroup &group);
+private:
+  int self() const;
+  int files() const { return (int)queues . size () - 1; }
+  int pending() const {
+    return __atomic_load_n (&queued, __ATOMIC_SEQ_CST) +
+           __atomic_load_n (&queued_outside, __ATOMIC_SEQ_CST);
+  }
+  bool runOne(int self, bool take_files);
+  void wake();
+  static void *work(void *arg);
+  taskPool(const taskPool &);
+  taskPool &operator= (const taskPool &);
+};
+
+// which pool's thread this is, and its queue
+static __thread taskPool *pool_here;
+static __thread int pool_self;
+
+// how many tasks this thread is running, one inside another
+static __thread int pool_depth;
+
+struct poolStart {
+  taskPool *pool;
+  int self;
+};
+
+taskPool::taskPool (int count)
+  : queues (count + 2), queued (0), queued_outside (0), stopping (false) {
+  for (size_t i = 0; i < queues . size (); ++i)
+    pthread_mutex_init (&queues [i] . lock, NULL);
+  pthread_mutex_init (&idle_lock, NULL);
+  pthread_cond_init (&idle, NULL);
+
+  for (int i = 0; i < count; ++i) {
+    poolStart *start = new poolStart;
+    start -> pool = this;
+    start -> self = i;
+    pthread_t id;
+    if (pthread_create (&id, NULL, work, start))
+      delete start;
+    else
+      threads . push_back (id);
+  }
+}
+
+taskPool::~taskPool () {
+  pthread_mutex_lock (&idle_lock);
+  stopping = true;
+  pthread_cond_broadcast (&idle);
+  pthread_mutex_unlock (&idle_lock);
+  for (size_t i = 0; i < threads . size (); ++i)
+    pthread_join (threads [i], NULL);
+
+  pthread_cond_destroy (&idle);
+  pthread_mutex_destroy (&idle_lock);
+  for (size_t i = 0; i < queues . size (); ++i)
+    pthread_mutex_destroy (&queues [i] . lock);
+}
+
+int taskPool::self () const {
+  return pool_here == this ? pool_self : (int)queues . size () - 2;
+}
+
+void taskPool::wake () {
+  pthread_mutex_lock (&idle_lock);
+  pthread_cond_broadcast (&idle);
+  pthread_mutex_unlock (&idle_lock);
+}
+
+void taskPool::spawn (taskGroup &group, void (*run)(void *), void *arg) {
+  task t;
+  t.run = run;
+  t.arg = arg;
+  t.group = &group;
+  __atomic_add_fetch (&group.pending, 1, __ATOMIC_SEQ_CST);
+
+  int to = pool_depth ? self () : files ();
+  queue &q = queues [to];
+  pthread_mutex_lock (&q.lock);
+  q.tasks . push_back (t);
+  pthread_mutex_unlock (&q.lock);
+  __atomic_add_fetch (to == files () ? &queued_outside : &queued, 1, __ATOMIC_SEQ_CST);
+  wake ();
+}
+
+// take_files is whether a file may be started, which only a thread
+// that is not inside a task does
+bool taskPool::runOne (int self, bool take_files) {
+  int n = (int)queues . size ();
+  task t;
+  int from = self;
+  bool got = false;
+
+  queue &own = queues [self];
+  pthread_mutex_lock (&own.lock);
+  if (! own.tasks . empty ()) {
+    t = own.tasks . back ();
+    own.tasks . pop_back ();
+    got = true;
+  }
+  pthread_mutex_unlock (&own.lock);
+
+  for (int k = 1; k < n && ! got; ++k) {
+    from = (self + k) % n;
+    if (! take_files && from == files ()) continue;
+    queue &q = queues [from];
+    pthread_mutex_lock (&q.lock);
+    if (! q.tasks . empty ()) {
+      t = q.tasks . front ();
+      q.tasks . pop_front ();
+      got = true;
+    }
+    pthread_mutex_unlock (&q.lock);
+  }
+  if (! got) return false;
+
+  __atomic_sub_fetch (from == files () ? &queued_outside : &queued, 1, __ATOMIC_SEQ_CST);
+  pool_depth++;
+  t.run (t.arg);
+  pool_depth--;
+  if (! __atomic_sub_fetch (&t.group -> pending, 1, __ATOMIC_SEQ_CST))
+    wake ();
+  return true;
+}
+
+void taskPool::wait (taskGroup &group) {
+  int me = self ();
+  bool take_files = ! pool_depth;
+  while (__atomic_load_n (&group.pending, __ATOMIC_SEQ_CST)) {
+    if (runOne (me, take_files)) continue;
+    pthread_mutex_lock (&idle_lock);
+    while (__atomic_load_n (&group.pending, __ATOMIC_SEQ_CST) &&
+           __atomic_load_n (&queued, __ATOMIC_SEQ_CST) <= 0 &&
+           (! take_files || __atomic_load_n (&queued_outside, __ATOMIC_SEQ_CST) <= 0))
+      pthread_cond_wait (&idle, &idle_lock);
+    pthread_mutex_unlock (&idle_lock);
+  }
+}
+
+void *taskPool::work (void *arg) {
+  poolStart *start = (poolStart *)arg;
+  taskPool *pool = start -> pool;
+  pool_here = pool;
+  pool_self = start -> self;
+  delete start;
+
+  for (;;) {
+    if (pool -> runOne (pool_self, true)) continue;
+    pthread_mutex_lock (&pool -> idle_lock);
+    while (pool -> pending () <= 0 && ! pool -> stopping)
+      pthread_cond_wait (&pool -> idle, &pool -> idle_lock);
+    bool stop = pool -> stopping && pool -> pending () <= 0;
+    pthread_mutex_unlock (&pool -> idle_lock);
+    if (stop) return NULL;
+  }
+}
+
+// b as a percentage of a, or zero
+static double percent (unsigned long long b, unsigned long long a) {
+  return a ? 100.0 * b / a : 0;
+}
+
+void tracer::printCounters (FILE *fp) {
+  // stages in the order they first ran, over every thread
+  vector <span> total;
+  pthread_mutex_lock (&lock);
+  for (size_t i = 0; i < spans . size (); ++i) {
+    const span &s = spans [i];
+    if (! s.counted) continue;
+    size_t j = 0;
+    while (j < total . size () && strcmp (total [j] . name, s.name)) ++j;
+    if (j == total . size ()) {
+      total . push_back (s);
+      continue;
+    }
+    for (int k = 0; k < perfCounters::COUNT; ++k)
+      total [j] . counts [k] += s.counts [k];
+  }
+  pthread_mutex_unlock (&lock);
+
+  if (total . empty ()) {
+    fprintf (fp, "no hardware counters; check /proc/sys/kernel/perf_event_paranoid\n");
+    return;
+  }
+
+  fprintf (fp, "%-10s %14s %14s %6s %12s %8s %12s %8s\n",
+               "stage", "cycles", "instructions", "ipc",
+               "cache miss", "rate", "branch miss", "rate");
+  for (size_t j = 0; j < total . size (); ++j) {
+    const unsigned long long *c = total [j] . counts;
+    double ipc = c [perfCounters::CYCLES] ?
+      (double)c [perfCounters::INSTRUCTIONS] / c [perfCounters::CYCLES] : 0;
+    fprintf (fp, "%-10s %14llu %14llu %6.2f %12llu %7.2f%% %12llu %7.2f%%\n",
+                 total [j] . name,
+                 c [perfCounters::CYCLES], c [perfCounters::INSTRUCTIONS], ipc,
+                 c [perfCounters::CACHE_MISSES],
+                 percent (c [perfCounters::CACHE_MISSES],
+                          c [perfCounters::CACHE_REFERENCES]),
+                 c [perfCounters::BRANCH_MISSES],
+                 percent (c [perfCounters::BRANCH_MISSES],
+                          c [perfCounters::BRANCHES]));
+  }
+}
+
+// all six in one group, so they are scheduled onto the pmu together
+// and read in a single call
+bool perfCounters::open () {
+  static const unsigned long long config [COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_REFERENCES,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES
+  };
+
+  for (int i = 0; i < COUNT; ++i) {
+    struct perf_event_attr attr;
+    memset (&attr, 0, sizeof (attr));
+    attr.size = sizeof (attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config [i];
+    attr.disabled = i == 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP |
+                       PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // this thread, on whichever cpu it runs
+    fd [i] = syscall (SYS_perf_event_open, &attr, 0, -1, i ? fd [0] : -1, 0);
+    if (fd [i] < 0) {
+      close ();
+      return false;
+    }
+  }
+
+  ioctl (fd [0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl (fd [0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  return true;
+}
+
+bool perfCounters::read (unsigned long long *counts) {
+  if (fd [0] < 0) return false;
+  ioctl (fd [0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+  // nr, time enabled, time running, then a value per counter
+  unsigned long long data [3 + COUNT];
+  ssize_t got = ::read (fd [0], data, sizeof (data));
+  close ();
+  if (got != (ssize_t)sizeof (data) || data [0] != COUNT || ! data [2])
+    return false;
+
+  double scale = (double)data [1] / data [2];
+  for (int i = 0; i < COUNT; ++i)
+    counts [i] = (unsigned long long)(data [3 + i] * scale);
+  return true;
+}
+
+void perfCounters::close () {
+  for (int i = 0; i < COUNT; ++i) {
+    if (fd [i] >= 0) ::close (fd [i]);
+    fd [i] = -1;
+  }
+}
+
+bool squarePoints(beam &opposite, beam &shared, const triangle &t1, const triangle &t2) {
+  if (t1 . sharedPoints (t2) != 2)
+    return false;
+
+  vect o1;
+  if (! t2.contains(t1.p1))
+    o1 = t1.p1;
+  else if (! t2.contains(t1.p2))
+    o1 = t1.p2;
+  else if (! t2.contains(t1.p3))
+    o1 = t1.p3;
+
+  vect o2;
+  if (! t1.contains(t2.p1))
+    o2 = t2.p1;
+  else if (! t1.contains(t2.p2))
+    o2 = t2.p2;
+  else if (! t1.contains(t2.p3))
+    o2 = t2.p3;
+
+  vect s1, s2;
+  if (t1.p1 == o1) {
+      s1 = t1.p2;
+      s2 = t1.p3;
+  } else if (t1.p2 == o1) {
+      s1 = t1.p1;
+      s2 = t1.p3;
+  } else if (t1.p3 == o1) {
+      s1 = t1.p1;
+      s2 = t1.p2;
+  }
+
+  opposite.set(o1, o2);
+  shared.set(s1, s2);
+
+  return true;
+}
+
+// orders beam indices by end points, then by position, so that
+// the first of each run of duplicates is the one found first
+struct beamOrder {
+  const edge *beams;
+  beamOrder(const edge *_beams) { beams = _beams; }
+  bool operator() (unsigned int a, unsigned int b) const {
+    const edge &ea = beams [a];
+    const edge &eb = beams [b];
+    if (ea . lo () != eb . lo ()) return ea . lo () < eb . lo ();
+    if (ea . hi () != eb . hi ()) return ea . hi () < eb . hi ();
+    return a < b;
+  }
+};
+
+// a normal and its reverse give the same key, so the triangles of one
+// plane sort together whichever way round they are wound
+static vect planeKey (const vect &n) {
+  vect r = n . neg ();
+  return n < r ? r : n;
+}
+
+// a triangle on an edge that is the longest of its three, by plane
+struct planeCandidate {
+  vect key;
+  unsigned int tri;
+  unsigned int opp;
+  bool operator< (const planeCandidate &c) const {
+    if (key < c.key) return true;
+    if (c.key < key) return false;
+    return tri < c.tri;
+  }
+};
+
+// the triangles of one plane in sorted candidates, each with the next.
+// a surface has at most two on an edge, which this pairs like any
+// other way would; a fan of many overlapping ones costs a sort rather
+// than every pair.
+template <typename F>
+static void pairInPlane (const vector <planeCandidate> &c, F &pair) {
+  for (size_t k = 1; k < c . size (); ++k)
+    if (c [k] . key == c [k - 1] . key)
+      pair (c [k - 1], c [k]);
+}
+
+static void addBeam (Mesh &mesh, unsigned int n1, unsigned int n2, unsigned int tri) {
+  if (mesh.beam_count < mesh.beam_cap)
+    mesh.beams [mesh.beam_count++] = edge (n1, n2, tri);
+}
+
+// every triangle edge, in the direction of its triangle's winding,
+// sorted so that triangles sharing an edge sit together
+void sortEdges (Mesh &mesh) {
+  mesh.edge_count = 0;
+  for (int i = 0; i < mesh.tri_count; ++i) {
+    const unsigned int *t = &mesh.tridx [i * 3];
+    for (int k = 0; k < 3; ++k)
+      mesh.edges [mesh.edge_count++] = edge (t[k], t[(k + 1) % 3], i);
+  }
+  sort (mesh.edges, mesh.edges + mesh.edge_count);
+}
+
+// collects the pairs of triangles from pairInPlane, both ways round
+struct nearPairs {
+  vector <pair <unsigned int, unsigned int> > &pairs;
+  nearPairs(vector <pair <unsigned int, unsigned int> > &_pairs) : pairs (_pairs) {}
+  void operator() (const planeCandidate &a, const planeCandidate &b) {
+    pairs . push_back (make_pair (a.tri, b.tri));
+    pairs . push_back (make_pair (b.tri, a.tri));
+  }
+};
+
+// co-planar triangles meeting on an edge that is the longest of both,
+// both ways round, by the first, over sorted edges
+static void pairEdges (const Mesh &mesh, const edge *edges, const edge *end,
+                       vector <pair <unsigned int, unsigned int> > &near) {
+  vector <planeCandidate> on_edge;
+  nearPairs found (near);
+  for (const edge *e = edges; e < end; ) {
+    const edge *first = e;
+    beam shared (mesh.nodes [first -> lo ()], mesh.nodes [first -> hi ()]);
+    on_edge . clear ();
+    for (; e < end && e -> lo () == first -> lo () && e -> hi () == first -> hi (); ++e) {
+      const triangle &t = mesh.triangles [e -> tri];
+      if (! t . isLongest (shared)) continue;
+      planeCandidate c;
+      c.key = planeKey (t . normal ());
+      c.tri = e -> tri;
+      c.opp = 0;
+      on_edge . push_back (c);
+    }
+    sort (on_edge . begin (), on_edge . end ());
+    pairInPlane (on_edge, found);
+  }
+}
+
+static bool sameTriangle (const triangle &a, const triangle &b) {
+  return a.p1 == b.p1 && a.p2 == b.p2 && a.p3 == b.p3;
+}
+
+// the pairs of the last conversion, with the ones around the triangles
+// that changed since found again. a triangle that shares a node with a
+// changed one, as it is now or as it was, may pair differently, so its
+// pairs are found from the edges of every triangle near it; the pairs
+// of the rest are as they were. false when too much changed for that
+// to beat finding them all.
+static bool pairAgain (Mesh &mesh, const convertState &last,
+                       vector <pair <unsigned int, unsigned int> > &near) {
+  int tsize = mesh.tri_count;
+  int last_size = (int)last.triangles . size ();
+  if (! last_size) return false;
+
+  // the nodes of the changed triangles, and where the old ones were
+  vector <char> dirty (mesh.node_count, 0);
+  vector <vect> moved;
+  int changed = 0;
+  for (int i = 0; i < max (tsize, last_size); ++i) {
+    if (i < tsize && i < last_size && sameTriangle (mesh.triangles [i], last.triangles [i]))
+      continue;
+    if (++changed > tsize / 4) return false;
+    if (i < last_size) {
+      moved . push_back (last.triangles [i] . p1);
+      moved . push_back (last.triangles [i] . p2);
+      moved . push_back (last.triangles [i] . p3);
+    }
+    if (i < tsize)
+      for (int k = 0; k < 3; ++k)
+        dirty [mesh.tridx [i * 3 + k]] = 1;
+  }
+  sort (moved . begin (), moved . end ());
+  moved . erase (unique (moved . begin (), moved . end ()), moved . end ());
+  if (! moved . empty ())
+    for (int n = 0; n < mesh.node_count; ++n)
+      if (binary_search (moved . begin (), moved . end (), mesh.nodes [n]))
+        dirty [n] = 1;
+
+  // the triangles the change reaches, and the nodes of those, whose
+  // triangles hold every one on an edge of a reached triangle
+  vector <char> reached (tsize, 0);
+  vector <char> around (dirty);
+  for (int i = 0; i < tsize; ++i) {
+    const unsigned int *t = &mesh.tridx [i * 3];
+    if (dirty [t[0]] || dirty [t[1]] || dirty [t[2]]) {
+      reached [i] = 1;
+      around [t[0]] = around [t[1]] = around [t[2]] = 1;
+    }
+  }
+  vector <edge> edges;
+  for (int i = 0; i < tsize; ++i) {
+    const unsigned int *t = &mesh.tridx [i * 3];
+    if (around [t[0]] || around [t[1]] || around [t[2]])
+      for (int k = 0; k < 3; ++k)
+        edges . push_back (edge (t[k], t[(k + 1) % 3], i));
+  }
+  sort (edges . begin (), edges . end ());
+  vector <pair <unsigned int, unsigned int> > found;
+  if (! edges . empty ())
+    pairEdges (mesh, &edges [0], &edges [0] + edges . size (), found);
+
+  near . clear ();
+  for (size_t k = 0; k < last.near . size (); ++k) {
+    const pair <unsigned int, unsigned int> &p = last.near [k];
+    if (p.first < (unsigned int)tsize && p.second < (unsigned int)tsize &&
+        ! reached [p.first] && ! reached [p.second])
+      near . push_back (p);
+  }
+  for (size_t k = 0; k < found . size (); ++k)
+    if (reached [found [k] . first] || reached [found [k] . second])
+      near . push_back (found [k]);
+  sort (near . begin (), near . end ());
+  near . erase (unique (near . begin (), near . end ()), near . end ());
+
+  LOG (mesh.verbosity, LOG_VERBOSE, "paired the triangles around %d changed ones again, %zu edges\n",
+       changed, edges . size ());
+  return true;
+}
+
+// the edge and cross beams of the mesh. with again, the pairs of
+// co-planar triangles are carried on from the last conversion where
+// the triangles did not change, and kept for the next.
+void extractBeams (Mesh &mesh, convertState *again = NULL) {
+  int tsize = mesh.tri_count;
+  const unsigned int *tridx = mesh.tridx;
+
+  // triangles by position for the geometric tests
+  for (int i = 0; i < tsize; ++i) {
+    const unsigned int *t = &tridx [i * 3];
+    new (&mesh.triangles [i]) triangle (mesh.nodes [t[0]],
+                                        mesh.nodes [t[1]],
+                                        mesh.nodes [t[2]]);
+  }
+  vector <pair <unsigned int, unsigned int> > near;
+  {
+    traceSpan span (mesh.trace, "adjacency", mesh.source);
+    if (! again || ! pairAgain (mesh, *again, near)) {
+      sortEdges (mesh);
+      pairEdges (mesh, mesh.edges, mesh.edges + mesh.edge_count, near);
+      sort (near . begin (), near . end ());
+      near . erase (unique (near . begin (), near . end ()), near . end ());
+    }
+    if (again) {
+      again -> triangles . assign (mesh.triangles, mesh.triangles + tsize);
+      again -> near = near;
+    }
+  }
+
+  mesh.beam_count = 0;
+  size_t n = 0;
+  for (int i = 0; i < tsize; ++i) {
+    const unsigned int *t = &tridx [i * 3];
+    const triangle &t1 = mesh.triangles [i];
+    // all triangle edges are beams
+    addBeam (mesh, t[0], t[1], i);
+    addBeam (mesh, t[1], t[2], i);
+    addBeam (mesh, t[2], t[0], i);
+
+    // for adjacent, co-planar triangles,
+    // add the beam between the opposing points
+    for (; n < near . size () && near [n] . first == (unsigned int)i; ++n) {
+      unsigned int j = near [n] . second;
+      const triangle &t2 = mesh.triangles [j];
+
+      // create a beam, if it is indeed a beam
+      beam opposite;
+      beam shared;
+      if (squarePoints(opposite, shared, t1, t2)) {
+        const unsigned int *u = &tridx [j * 3];
+        unsigned int o1 = t[0], o2 = u[0];
+        for (int k = 0; k < 3; ++k) {
+          if (t[k] != u[0] && t[k] != u[1] && t[k] != u[2]) o1 = t[k];
+          if (u[k] != t[0] && u[k] != t[1] && u[k] != t[2]) o2 = u[k];
+        }
+        addBeam (mesh, o1, o2, NO_TRI);
+      }
+    }
+  }
+
+  if (mesh.beam_count == mesh.beam_cap)
+    LOG (mesh.verbosity, LOG_NORMAL, "beam storage full, some cross beams were dropped\n");
+
+  // keep only the first beam between any two nodes
+  int bs = mesh.beam_count;
+  for (int i = 0; i < bs; ++i)
+    mesh.scratch [i] = i;
+  sort (mesh.scratch, mesh.scratch + bs, beamOrder (mesh.beams));
+  for (int i = 1; i < bs; ++i) {
+    const edge &a = mesh.beams [mesh.scratch [i - 1]];
+    edge &b = mesh.beams [mesh.scratch [i]];
+    if (a . lo () == b . lo () && a . hi () == b . hi ())
+      b.tri = DUP_TRI;
+  }
+  mesh.beam_count = 0;
+  for (int i = 0; i < bs; ++i) {
+    const edge &b = mesh.beams [i];
+    if (b.tri == DUP_TRI) continue;
+    if (b.tri == NO_TRI && mesh.verbosity >= LOG_TRACE) {
+      printf("found cross beam: ");
+      beam (mesh.nodes [b.n1], mesh.nodes [b.n2]) . print (true);
+    }
+    mesh.beams [mesh.beam_count++] = b;
+  }
+
+  LOG (mesh.verbosity, LOG_NORMAL, "extracted %d beams\n", mesh.beam_count);
+}
+
+// (3,6) pebble game over the beam graph, the usual combinatorial
+// stand-in for generic rigidity in 3d. every node starts with three
+// pebbles, one per degree of freedom, and each kept beam pins one of
+// them down. out[a] holds b when a pebble on a covers the beam a-b,
+// links holds every kept beam in both directions.
+struct pebbleGame {
+  vector <unsigned char> pebbles;
+  vector <vector <unsigned int> > out;
+  vector <vector <unsigned int> > links;
+  vector <unsigned int> seen;
+  vector <unsigned int> from;
+  vector <unsigned int> queue;
+  unsigned int mark;
+
+  pebbleGame(int node_count)
+    : pebbles (node_count, 3), out (node_count), links (node_count),
+      seen (node_count, 0), from (node_count, 0), mark (0) {}
+
+  // search along covered beams for a free pebble and shuffle it back
+  // to node n, reversing the beams on the way. a and b are the ends
+  // of the beam being tested and must keep their own pebbles.
+  bool fetch(unsigned int n, unsigned int a, unsigned int b) {
+    ++mark;
+    queue . clear ();
+    queue . push_back (n);
+    seen [n] = mark;
+    for (size_t head = 0; head < queue . size (); ++head) {
+      unsigned int p = queue [head];
+      for (size_t i = 0; i < out [p] . size (); ++i) {
+        unsigned int q = out [p] [i];
+        if (seen [q] == mark) continue;
+        seen [q] = mark;
+        from [q] = p;
+        if (q != a && q != b && pebbles [q]) {
+          pebbles [q]--;
+          pebbles [n]++;
+          while (q != n) {
+            unsigned int r = from [q];
+            vector <unsigned int> &ro = out [r];
+            ro . erase (find (ro . begin (), ro . end (), q));
+            out [q] . push_back (r);
+            q = r;
+          }
+          return true;
+        }
+        if (q != a && q != b) queue . push_back (q);
+      }
+    }
+    return false;
+  }
+
+  // keep the beam a-b if it removes a degree of freedom
+  bool add(unsigned int a, unsigned int b) {
+    while (pebbles [a] < 3 && fetch (a, a, b)) ;
+    while (pebbles [b] < 3 && fetch (b, a, b)) ;
+    if (pebbles [a] + pebbles [b] < 6) return false;
+
+    // with six pebbles held on a and b, every neighbour must still be
+    // able to find a seventh. one that can't has only reached nodes
+    // already braced to 3n-6 beams, so a-b would add nothing.
+    for (int k = 0; k < 2; ++k) {
+      const vector <unsigned int> &near = links [k ? b : a];
+      for (size_t i = 0; i < near . size (); ++i) {
+        unsigned int c = near [i];
+        if (c == a || c == b || pebbles [c]) continue;
+        if (! fetch (c, a, b)) return false;
+      }
+    }
+
+    pebbles [a]--;
+    out [a] . push_back (b);
+    links [a] . push_back (b);
+    links [b] . push_back (a);
+    return true;
+  }
+};
+
+// is a-b an edge of any triangle
+static bool surfaceEdge (const Mesh &mesh, unsigned int a, unsigned int b) {
+  edge key (a, b, 0);
+  const edge *end = mesh.edges + mesh.edge_count;
+  const edge *e = lower_bound ((const edge *)mesh.edges, end, key);
+  return e < end && e -> lo () == key . lo () && e -> hi () == key . hi ();
+}
+
+// drop the beams that add no rigidity, surface edges are tried first
+// so that redundant cross beams are the ones to go. margin is the
+// fraction of the redundant beams to put back as a safety factor.
+void pruneBeams (Mesh &mesh, double margin) {
+  int bs = mesh.beam_count;
+
+  vector <int> tried;
+  for (int pass = 0; pass < 2; ++pass)
+    for (int i = 0; i < bs; ++i) {
+      const edge &b = mesh.beams [i];
+      if (surfaceEdge (mesh, b.n1, b.n2) == (pass == 0)) tried . push_back (i);
+    }
+
+  pebbleGame game (mesh.node_count);
+  vector <char> keep (bs, 0);
+  vector <int> redundant;
+  for (int i = 0; i < (int)tried . size (); ++i) {
+    const edge &b = mesh.beams [tried [i]];
+    if (game . add (b.n1, b.n2))
+      keep [tried [i]] = 1;
+    else
+      redundant . push_back (tried [i]);
+  }
+
+  int restore = (int)ceil (margin * redundant . size ());
+  for (int i = 0; i < restore; ++i)
+    keep [redundant [i]] = 1;
+
+  mesh.beam_count = 0;
+  for (int i = 0; i < bs; ++i)
+    if (keep [i]) mesh.beams [mesh.beam_count++] = mesh.beams [i];
+
+  LOG (mesh.verbosity, LOG_NORMAL, "pruned %d of %d beams, %d redundant beams kept\n",
+           bs - mesh.beam_count, bs, restore);
+}
+
+// sorts more records than fit in memory. each full buffer is sorted
+// and written to a temporary file as a run, and the runs are merged
+// back in order when read.
+template <typename T> struct externalSort {
+  vector <T> buffer;
+  size_t limit;
+  vector <FILE *> runs;
+  size_t next_in_buffer;
+  priority_queue <pair <T, int>, vector <pair <T, int> >, greater <pair <T, int> > > heads;
+
+  externalSort(size_t bytes) {
+    limit = max (bytes / sizeof (T), (size_t)1024);
+    next_in_buffer = 0;
+  }
+  ~externalSort() {
+    for (size_t i = 0; i < runs . size (); ++i)
+      fclose (runs [i]);
+  }
+
+  bool spill() {
+    sort (buffer . begin (), buffer . end ());
+    FILE *run = tmpfile ();
+    if (! run) return false;
+    if (fwrite (&buffer [0], sizeof (T), buffer . size (), run) != buffer . size ()) {
+      fclose (run);
+      return false;
+    }
+    rewind (run);
+    runs . push_back (run);
+    buffer . clear ();
+    return true;
+  }
+
+  bool push(const T &t) {
+    if (buffer . capacity () < limit) buffer . reserve (limit);
+    buffer . push_back (t);
+    if (buffer . size () < limit) return true;
+    return spill ();
+  }
+
+  // done pushing, ready the records for reading in order
+  bool finish() {
+    if (runs . empty ()) {
+      sort (buffer . begin (), buffer . end ());
+      return true;
+    }
+    if (! buffer . empty () && ! spill ()) return false;
+    vector <T> () . swap (buffer);
+    for (int i = 0; i < (int)runs . size (); ++i) {
+      T t;
+      if (fread (&t, sizeof (T), 1, runs [i]) == 1)
+        heads . push (make_pair (t, i));
+    }
+    return true;
+  }
+
+  bool next(T &t) {
+    if (runs . empty ()) {
+      if (next_in_buffer >= buffer . size ()) return false;
+      t = buffer [next_in_buffer++];
+      return true;
+    }
+    if (heads . empty ()) return false;
+    t = heads . top () . first;
+    int run = heads . top () . second;
+    heads . pop ();
+    T more;
+    if (fread (&more, sizeof (T), 1, runs [run]) == 1)
+      heads . push (make_pair (more, run));
+    return true;
+  }
+};
+
+// one triangle edge on its way through the external sort
+struct edgeRecord {
+  unsigned int lo;
+  unsigned int hi;
+  unsigned int tri;
+  unsigned int opp;       // the triangle's node across from this edge
+  unsigned int longest;   // is this the triangle's longest edge
+  vect normal;
+  bool operator< (const edgeRecord &e) const {
+    if (lo != e.lo) return lo < e.lo;
+    if (hi != e.hi) return hi < e.hi;
+    return tri < e.tri;
+  }
+  bool operator> (const edgeRecord &e) const { return e < *this; }
+};
+
+// a beam on its way through the external sort
+struct beamRecord {
+  unsigned int lo;
+  unsigned int hi;
+  bool operator< (const beamRecord &b) const {
+    if (lo != b.lo) return lo < b.lo;
+    return hi < b.hi;
+  }
+  bool operator> (const beamRecord &b) const { return b < *this; }
+};
+
+// a triangle as read, before welding
+struct rawTriangle {
+  unsigned int t[3];
+};
+
+// how many records go between the pipelined stages at a time
+#define PIPE_BLOCK 4096
+#define PIPE_SLOTS 8
+
+template <typename T> struct itemBlock {
+  T items[PIPE_BLOCK];
+  int count;
+};
+
+// a bounded queue of blocks between one producer and one consumer. the
+// producer fills the slot it claims and publishes it, the consumer
+// reads the slot in place and releases it, and each sleeps on the lock's
+// condition while the other catches up, so a stage that is ahead gives
+// its processor to the one behind. the lock is taken once per block, not
+// per record. the consumer can abandon the queue, which makes the
+// producer's next claim fail.
+template <typename B> struct blockQueue {
+  B slots[PIPE_SLOTS];
+  unsigned long head;     // next slot to read, moved by the consumer
+  unsigned long tail;     // next slot to fill, moved by the producer
+  bool closed;
+  bool abandoned;
+  pthread_mutex_t lock;
+  pthread_cond_t moved;   // head or tail moved, or the queue was shut
+
+  blockQueue() : head (0), tail (0), closed (false), abandoned (false) {
+    pthread_mutex_init (&lock, NULL);
+    pthread_cond_init (&moved, NULL);
+  }
+  ~blockQueue() {
+    pthread_cond_destroy (&moved);
+    pthread_mutex_destroy (&lock);
+  }
+
+  B *claim() {
+    pthread_mutex_lock (&lock);
+    while (tail - head == PIPE_SLOTS && ! abandoned)
+      pthread_cond_wait (&moved, &lock);
+    B *slot = abandoned ? NULL : &slots [tail % PIPE_SLOTS];
+    pthread_mutex_unlock (&lock);
+    return slot;
+  }
+  void publish() { step (tail); }
+  void close() { shut (closed); }
+
+  // the next full slot, or NULL once the producer is done
+  B *next() {
+    pthread_mutex_lock (&lock);
+    while (head == tail && ! closed)
+      pthread_cond_wait (&moved, &lock);
+    B *slot = head == tail ? NULL : &slots [head % PIPE_SLOTS];
+    pthread_mutex_unlock (&lock);
+    return slot;
+  }
+  void release() { step (head); }
+  void abandon() { shut (abandoned); }
+
+private:
+  void step(unsigned long &end) {
+    pthread_mutex_lock (&lock);
+    end++;
+    pthread_cond_signal (&moved);
+    pthread_mutex_unlock (&lock);
+  }
+  void shut(bool &flag) {
+    pthread_mutex_lock (&lock);
+    flag = true;
+    pthread_cond_signal (&moved);
+    pthread_mutex_unlock (&lock);
+  }
+  blockQueue(const blockQueue &);
+  blockQueue &operator= (const blockQueue &);
+};
+
+// hands records to the next stage's thread a block at a time
+template <typename T> struct queueSink {
+  blockQueue <itemBlock <T> > &queue;
+  itemBlock <T> *block;
+
+  queueSink(blockQueue <itemBlock <T> > &_queue) : queue (_queue), block (NULL) {}
+  bool push(const T &t) {
+    if (! block) {
+      block = queue . claim ();
+      if (! block) return false;
+      block -> count = 0;
+    }
+    block -> items [block -> count++] = t;
+    if (block -> count == PIPE_BLOCK) {
+      queue . publish ();
+      block = NULL;
+    }
+    return true;
+  }
+  void close() {
+    if (block) queue . publish ();
+    block = NULL;
+    queue . close ();
+  }
+};
+
+// a welded triangle with no area, or one that uses a node twice
+static bool degenerateTriangle (const vect *nodes, const unsigned int *t) {
+  if (t[0] == t[1] || t[1] == t[2] || t[0] == t[2]) return true;
+  const vect &p1 = nodes [t[0]];
+  const vect &p2 = nodes [t[1]];
+  const vect &p3 = nodes [t[2]];
+  return (p2 - p1) . cross (p3 - p1) . mag_sq () == 0;
+}
+
+// welds each triangle through remap and sorts its three edges. the
+// degenerate triangles are dropped here, as cleanTriangles does in
+// memory; duplicates are only seen once their edges are merged.
+struct edgeSink {
+  const Mesh &mesh;
+  const vector <unsigned int> &remap;
+  externalSort <edgeRecord> &edges;
+  unsigned int tri_count;
+  unsigned int degenerate;
+
+  edgeSink(const Mesh &_mesh, const vector <unsigned int> &_remap,
+           externalSort <edgeRecord> &_edges)
+    : mesh (_mesh), remap (_remap), edges (_edges), tri_count (0), degenerate (0) {}
+  bool push(const rawTriangle &r) {
+    unsigned int t[3];
+    for (int k = 0; k < 3; ++k)
+      t[k] = remap [r.t[k]];
+    if (degenerateTriangle (mesh.nodes, t)) {
+      degenerate++;
+      return true;
+    }
+
+    triangle tr (mesh.nodes [t[0]], mesh.nodes [t[1]], mesh.nodes [t[2]]);
+    vect normal = tr . normal ();
+    for (int k = 0; k < 3; ++k) {
+      edgeRecord e;
+      e.lo = min (t[k], t[(k + 1) % 3]);
+      e.hi = max (t[k], t[(k + 1) % 3]);
+      e.tri = tri_count;
+      e.opp = t[(k + 2) % 3];
+      e.longest = tr . isLongest (beam (mesh.nodes [e.lo], mesh.nodes [e.hi]));
+      e.normal = normal;
+      if (! edges . push (e)) return false;
+    }
+    tri_count++;
+    return true;
+  }
+};
+
+// the triangles in the <p> text whose points are all in range, into
+// out. the number of indices read, or -1 if out refused one. reading
+// stops one triangle past max_triangles, if that is set.
+template <typename Sink>
+static int readTriangles (const char *text, unsigned int raw_count, int max_triangles,
+                          int verbosity, Sink &out) {
+  int tri_points = 0;
+  rawTriangle r;
+  const char *s = text ? text : "";
+  for (;;) {
+    char *end;
+    unsigned long v = strtoul (s, &end, 0);
+    if (end == s) break;
+    s = end;
+    r.t[tri_points++ % 3] = (unsigned int)v;
+    if (tri_points % 3) continue;
+    if (max_triangles && tri_points / 3 > max_triangles) break;
+
+    if (r.t[0] >= raw_count || r.t[1] >= raw_count || r.t[2] >= raw_count) {
+      LOG (verbosity, LOG_NORMAL, "triangle vertex index out of node range: %u, %u, %u > %u\n",
+               r.t[0], r.t[1], r.t[2], raw_count);
+      continue;
+    }
+    if (! out . push (r)) return -1;
+  }
+  return tri_points;
+}
+
+// orders the triangles on one edge by their far node
+struct byOpposite {
+  bool operator() (const edgeRecord &a, const edgeRecord &b) const {
+    if (a.opp != b.opp) return a.opp < b.opp;
+    return a.tri < b.tri;
+  }
+};
+
+// pushes the cross beam between the far nodes of pairInPlane's pairs
+template <typename Sink> struct crossBeams {
+  Sink &found;
+  bool ok;
+  crossBeams(Sink &_found) : found (_found), ok (true) {}
+  void operator() (const planeCandidate &a, const planeCandidate &b) {
+    beamRecord r;
+    r.lo = min (a.opp, b.opp);
+    r.hi = max (a.opp, b.opp);
+    if (ok) ok = found . push (r);
+  }
+};
+
+// every edge is a beam, and coplanar triangles meeting on an edge
+// that is the longest of both get a cross beam between their far nodes.
+// two triangles on the same edge with the same far node are the same
+// triangle given twice, so all but the first are dropped and counted
+// in duplicates, three times each.
+template <typename Sink>
+static bool mergeEdges (externalSort <edgeRecord> &edges, Sink &found,
+                        unsigned long &duplicates) {
+  vector <edgeRecord> group;
+  vector <planeCandidate> on_edge;
+  crossBeams <Sink> cross (found);
+  edgeRecord e;
+  bool more = edges . next (e);
+  while (more) {
+    group . clear ();
+    group . push_back (e);
+    while ((more = edges . next (e)) && e.lo == group [0] . lo && e.hi == group [0] . hi)
+      group . push_back (e);
+
+    sort (group . begin (), group . end (), byOpposite ());
+    size_t kept = 1;
+    for (size_t i = 1; i < group . size (); ++i)
+      if (group [i] . opp != group [kept - 1] . opp)
+        group [kept++] = group [i];
+    duplicates += group . size () - kept;
+    group . resize (kept);
+
+    beamRecord b;
+    b.lo = group [0] . lo;
+    b.hi = group [0] . hi;
+    if (! found . push (b)) return false;
+
+    on_edge . clear ();
+    for (size_t i = 0; i < group . size (); ++i) {
+      if (! group [i] . longest) continue;
+      planeCandidate c;
+      c.key = planeKey (group [i] . normal);
+      c.tri = group [i] . tri;
+      c.opp = group [i] . opp;
+      on_edge . push_back (c);
+    }
+    sort (on_edge . begin (), on_edge . end ());
+    pairInPlane (on_edge, cross);
+    if (! cross.ok) return false;
+  }
+  return true;
+}
+
+// the threads of the pipelined stages
+struct tokenizeStage {
+  const char *text;
+  unsigned int raw_count;
+  int max_triangles;
+  int verbosity;
+  blockQueue <itemBlock <rawTriangle> > *queue;
+  int tri_points;
+};
+
+static void *runTokenize (void *arg) {
+  tokenizeStage *st = (tokenizeStage *)arg;
+  queueSink <rawTriangle> out (*st -> queue);
+  st -> tri_points = readTriangles (st -> text, st -> raw_count, st -> max_triangles,
+                                    st -> verbosity, out);
+  out . close ();
+  return NULL;
+}
+
+struct beamSortStage {
+  blockQueue <itemBlock <beamRecord> > *queue;
+  externalSort <beamRecord> *found;
+  bool ok;
+};
+
+static void *runBeamSort (void *arg) {
+  beamSortStage *st = (beamSortStage *)arg;
+  st -> ok = true;
+  while (itemBlock <beamRecord> *block = st -> queue -> next ()) {
+    for (int i = 0; i < block -> count && st -> ok; ++i)
+      st -> ok = st -> found -> push (block -> items [i]);
+    st -> queue -> release ();
+    if (! st -> ok) {
+      st -> queue -> abandon ();
+      break;
+    }
+  }
+  return NULL;
+}
+
+// extractBeams for meshes whose triangles don't fit in memory. the
+// triangle indices are read straight from the <p> text, welded
+// through remap, and each triangle edge goes to an external sort.
+// merging the runs brings the triangles on each edge together, which
+// gives the edge beams and cross beams. those go through a second
+// sort to drop duplicates and end up, in order, in mesh.spill.
+// mem_limit bounds the two sort buffers together. the count attribute
+// can't be trusted, so max_triangles is held to the triangles read.
+// SKETCHER_TOO_LARGE past it, SKETCHER_SPILL if the disk fails.
+//
+// pipelined, the tokenizer runs on a thread of its own and hands the
+// triangles over in blocks, and so does the edge merge to the beam
+// sort, so that parsing overlaps welding and sorting and the merge
+// overlaps the beam runs being written. the queues hold a few hundred
+// kilobytes at most.
+int extractBeamsExternal (Mesh &mesh, const vector <unsigned int> &remap,
+                          const char *tri_text, size_t mem_limit, bool pipeline,
+                          int max_triangles) {
+  externalSort <edgeRecord> edges (mem_limit / 2);
+  externalSort <beamRecord> found (mem_limit / 2);
+  unsigned int raw_count = (unsigned int)remap . size ();
+
+  edgeSink welded (mesh, remap, edges);
+  int tri_points;
+  if (! pipeline) {
+    tri_points = readTriangles (tri_text, raw_count, max_triangles, mesh.verbosity, welded);
+  } else {
+    blockQueue <itemBlock <rawTriangle> > *queue = new blockQueue <itemBlock <rawTriangle> >;
+    tokenizeStage st;
+    st.text = tri_text;
+    st.raw_count = raw_count;
+    st.max_triangles = max_triangles;
+    st.verbosity = mesh.verbosity;
+    st.queue = queue;
+    pthread_t id;
+    if (pthread_create (&id, NULL, runTokenize, &st)) {
+      delete queue;
+      return SKETCHER_SPILL;
+    }
+
+    bool ok = true;
+    while (itemBlock <rawTriangle> *block = queue -> next ()) {
+      for (int i = 0; i < block -> count && ok; ++i)
+        ok = welded . push (block -> items [i]);
+      queue -> release ();
+      if (! ok) {
+        queue -> abandon ();
+        break;
+      }
+    }
+    pthread_join (id, NULL);
+    delete queue;
+    tri_points = ok ? st.tri_points : -1;
+  }
+  if (tri_points < 0) return SKETCHER_SPILL;
+  if (max_triangles && tri_points / 3 > max_triangles) {
+    printf ("more than %d triangles\n", max_triangles);
+    return SKETCHER_TOO_LARGE;
+  }
+  LOG (mesh.verbosity, LOG_VERBOSE, "found %d triangle indices\n", tri_points);
+  LOG (mesh.verbosity, LOG_VERBOSE, "extracted %u triangles\n", welded.tri_count + welded.degenerate);
+
+  if (! edges . finish ()) return SKETCHER_SPILL;
+  LOG (mesh.verbosity, LOG_VERBOSE, "sorted %u edges in %d runs\n", welded.tri_count * 3, (int)edges . runs . size ());
+
+  unsigned long duplicates = 0;
+  if (! pipeline) {
+    if (! mergeEdges (edges, found, duplicates)) return SKETCHER_SPILL;
+  } else {
+    blockQueue <itemBlock <beamRecord> > *queue = new blockQueue <itemBlock <beamRecord> >;
+    beamSortStage st;
+    st.queue = queue;
+    st.found = &found;
+    pthread_t id;
+    if (pthread_create (&id, NULL, runBeamSort, &st)) {
+      delete queue;
+      return SKETCHER_SPILL;
+    }
+
+    queueSink <beamRecord> out (*queue);
+    bool merged = mergeEdges (edges, out, duplicates);
+    out . close ();
+    pthread_join (id, NULL);
+    delete queue;
+    if (! merged || ! st.ok) return SKETCHER_SPILL;
+  }
+
+  LOG (mesh.verbosity, LOG_NORMAL, "dropped %u degenerate and %lu duplicate triangles of %u\n",
+           welded.degenerate, duplicates / 3, welded.tri_count + welded.degenerate);
+
+  if (! found . finish ()) return SKETCHER_SPILL;
+  if (mesh.spill) fclose (mesh.spill);
+  mesh.spill = tmpfile ();
+  if (! mesh.spill) return SKETCHER_SPILL;
+  mesh.spill_count = 0;
+
+  beamRecord b, last;
+  bool first = true;
+  while (found . next (b)) {
+    if (! first && b.lo == last.lo && b.hi == last.hi) continue;
+    edge out (b.lo, b.hi);
+    if (fwrite (&out, sizeof (edge), 1, mesh.spill) != 1) return SKETCHER_SPILL;
+    mesh.spill_count++;
+    last = b;
+    first = false;
+  }
+
+  LOG (mesh.verbosity, LOG_NORMAL, "extracted %d beams\n", mesh.spill_count);
+  return SKETCHER_OK;
+}
+
+void extractTriangles (Mesh &mesh, const vector <unsigned int> &tridx) {
+  int node_count = mesh.node_count;
+
+  int tri_points = (int)tridx . size ();
+  int tri_count = tri_points / 3;
+  if (tri_count * 3 != tri_points)
+    LOG (mesh.verbosity, LOG_NORMAL, "incomplete triangle count: %d", tri_count);
+
+  mesh.tri_count = 0;
+  for (int i = 0; i < tri_count && mesh.tri_count < mesh.tri_cap; ++i) {
+    int idx = i * 3;
+    unsigned int vidx1 = tridx [idx];
+    unsigned int vidx2 = tridx [idx+1];
+    unsigned int vidx3 = tridx [idx+2];
+
+    // unsigned, so that "-1" wrapped by strtoul is out of range too
+    if (vidx1 >= (unsigned int)node_count ||
+        vidx2 >= (unsigned int)node_count ||
+        vidx3 >= (unsigned int)node_count) {
+      LOG (mesh.verbosity, LOG_NORMAL, "triangle vertex index out of node range: %u, %u, %u > %d\n",
+               vidx1, vidx2, vidx3, node_count);
+      continue;
+    }
+
+    unsigned int *t = &mesh.tridx [mesh.tri_count++ * 3];
+    t[0] = vidx1;
+    t[1] = vidx2;
+    t[2] = vidx3;
+  }
+
+  LOG (mesh.verbosity, LOG_VERBOSE, "extracted %d triangles\n", mesh.tri_count);
+}
+
+void extractNodes (Mesh &mesh, const vector <double> &node_dims) {
+  int node_elems = (int)node_dims . size ();
+  int node_count = node_elems / 3;
+  if (node_count * 3 != node_elems)
+    LOG (mesh.verbosity, LOG_NORMAL, "incomplete node count: %d", node_count);
+
+  mesh.node_count = min (node_count, mesh.node_cap);
+  for (int i = 0; i < mesh.node_count; ++i) {
+    int idx = i * 3;
+    new (&mesh.nodes [i]) vect (node_dims [idx],
+                                node_dims [idx+1],
+                                node_dims [idx+2]);
+  }
+
+  LOG (mesh.verbosity, LOG_VERBOSE, "extracted %d nodes\n", mesh.node_count);
+}
+
+// weldPoints, carried on from an earlier weld whose first same points
+// were these: remap holds where those went and seen the nodes that weld
+// made. the nodes of the first points are taken over as they were, and
+// only the points after them are looked up.
+static void weldFrom (Mesh &mesh, vector <unsigned int> &remap,
+                      map <vect, unsigned int> &seen, int same) {
+  int node_count = mesh.node_count;
+
+  remap . resize (node_count);
+  int welded = 0;
+  for (int i = 0; i < same; ++i)
+    if (remap [i] == (unsigned int)welded)
+      mesh.nodes [welded++] = mesh.nodes [i];
+  // forget the nodes the points after those made
+  for (map <vect, unsigned int>::iterator it = seen . begin (); it != seen . end (); )
+    if (it -> second >= (unsigned int)welded)
+      seen . erase (it++);
+    else
+      ++it;
+
+  for (int i = same; i < node_count; ++i) {
+    map <vect, unsigned int>::iterator it = seen . find (mesh.nodes [i]);
+    if (it != seen . end ()) {
+      remap [i] = it -> second;
+      continue;
+    }
+    remap [i] = welded;
+    seen [mesh.nodes [i]] = welded;
+    mesh.nodes [welded++] = mesh.nodes [i];
+  }
+
+  LOG (mesh.verbosity, LOG_NORMAL, "welded %d nodes into %d\n", node_count, welded);
+  mesh.node_count = welded;
+}
+
+// sketchup repeats a vertex for every face that uses it, so merge
+// points with identical positions into one node and remap the
+// triangle indices onto the merged nodes
+void weldPoints (Mesh &mesh, vector <unsigned int> &remap) {
+  map <vect, unsigned int> seen;
+  weldFrom (mesh, remap, seen, 0);
+}
+
+static void remapTriangles (Mesh &mesh, const vector <unsigned int> &remap) {
+  for (int i = 0; i < mesh.tri_count * 3; ++i)
+    mesh.tridx [i] = remap [mesh.tridx [i]];
+}
+
+void weldNodes (Mesh &mesh) {
+  vector <unsigned int> remap;
+  weldPoints (mesh, remap);
+  remapTriangles (mesh, remap);
+}
+
+// orders triangles by their sorted node indices, so the same triangle
+// wound either way sorts together, first one first
+struct triangleOrder {
+  const unsigned int *tridx;
+  triangleOrder(const unsigned int *_tridx) { tridx = _tridx; }
+  static void key(const unsigned int *t, unsigned int *k) {
+    k[0] = t[0]; k[1] = t[1]; k[2] = t[2];
+    if (k[0] > k[1]) swap (k[0], k[1]);
+    if (k[1] > k[2]) swap (k[1], k[2]);
+    if (k[0] > k[1]) swap (k[0], k[1]);
+  }
+  bool operator() (unsigned int a, unsigned int b) const {
+    unsigned int ka[3], kb[3];
+    key (&tridx [a * 3], ka);
+    key (&tridx [b * 3], kb);
+    for (int j = 0; j < 3; ++j)
+      if (ka[j] != kb[j]) return ka[j] < kb[j];
+    return a < b;
+  }
+};
+
+// drop triangles with no area after welding, and all but the first
+// of any triangle given more than once, like both faces of a two
+// sided surface
+void cleanTriangles (Mesh &mesh) {
+  int tri_count = mesh.tri_count;
+  int degenerate = 0;
+  int kept = 0;
+  for (int f = 0; f < tri_count; ++f) {
+    const unsigned int *t = &mesh.tridx [f * 3];
+    if (degenerateTriangle (mesh.nodes, t)) {
+      degenerate++;
+      continue;
+    }
+    for (int j = 0; j < 3; ++j)
+      mesh.tridx [kept * 3 + j] = t[j];
+    kept++;
+  }
+
+  int ts = kept;
+  for (int f = 0; f < ts; ++f)
+    mesh.scratch [f] = f;
+  sort (mesh.scratch, mesh.scratch + ts, triangleOrder (mesh.tridx));
+  vector <char> duplicate (ts, 0);
+  for (int i = 1; i < ts; ++i) {
+    unsigned int ka[3], kb[3];
+    triangleOrder::key (&mesh.tridx [mesh.scratch [i - 1] * 3], ka);
+    triangleOrder::key (&mesh.tridx [mesh.scratch [i] * 3], kb);
+    if (ka[0] == kb[0] && ka[1] == kb[1] && ka[2] == kb[2])
+      duplicate [mesh.scratch [i]] = 1;
+  }
+  kept = 0;
+  for (int f = 0; f < ts; ++f) {
+    if (duplicate [f]) continue;
+    for (int j = 0; j < 3; ++j)
+      mesh.tridx [kept * 3 + j] = mesh.tridx [f * 3 + j];
+    kept++;
+  }
+
+  mesh.tri_count = kept;
+  LOG (mesh.verbosity, LOG_NORMAL, "dropped %d degenerate and %d duplicate triangles of %d\n",
+           degenerate, ts - kept, tri_count);
+}
+
+// union-find with path halving and union by size
+struct disjointSets {
+  vector <unsigned int> parent;
+  vector <unsigned int> size;
+
+  disjointSets(int count) : parent (count), size (count, 1) {
+    for (int i = 0; i < count; ++i)
+      parent [i] = i;
+  }
+  unsigned int find(unsigned int a) {
+    while (parent [a] != a) {
+      parent [a] = parent [parent [a]];
+      a = parent [a];
+    }
+    return a;
+  }
+  void unite(unsigned int a, unsigned int b) {
+    a = find (a);
+    b = find (b);
+    if (a == b) return;
+    if (size [a] < size [b]) swap (a, b);
+    parent [b] = a;
+    size [a] += size [b];
+  }
+};
+
+// label the surfaces of a mesh, the sets of nodes joined through
+// triangles, numbered 0 up in order of their first node. nodes on no
+// triangle are labelled NO_TRI. returns the number of surfaces.
+int labelSurfaces (const Mesh &mesh, vector <unsigned int> &label) {
+  disjointSets sets (mesh.node_count);
+  vector <char> used (mesh.node_count, 0);
+  for (int f = 0; f < mesh.tri_count; ++f) {
+    const unsigned int *t = &mesh.tridx [f * 3];
+    sets . unite (t[0], t[1]);
+    sets . unite (t[0], t[2]);
+    used [t[0]] = used [t[1]] = used [t[2]] = 1;
+  }
+
+  label . assign (mesh.node_count, NO_TRI);
+  vector <unsigned int> root (mesh.node_count, NO_TRI);
+  int count = 0;
+  for (int i = 0; i < mesh.node_count; ++i) {
+    if (! used [i]) continue;
+    unsigned int r = sets . find (i);
+    if (root [r] == NO_TRI) root [r] = count++;
+    label [i] = root [r];
+  }
+  return count;
+}
+
+// the model should be one continuous surface, say so if it isn't
+void reportSurfaces (const Mesh &mesh) {
+  vector <unsigned int> label;
+  int count = labelSurfaces (mesh, label);
+  int isolated = (int)std::count (label . begin (), label . end (), NO_TRI);
+
+  LOG (mesh.verbosity, LOG_NORMAL, "found %d surfaces\n", count);
+  if (count > 1)
+    LOG (mesh.verbosity, LOG_NORMAL, "the model is not a single continuous surface\n");
+  if (isolated)
+    LOG (mesh.verbosity, LOG_NORMAL, "%d nodes are on no triangle\n", isolated);
+}
+
+// error quadric of a set of planes, stored as the upper
+// triangle of the symmetric 4x4 matrix
+struct quadric {
+  double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+  quadric() { a2 = ab = ac = ad = b2 = bc = bd = c2 = cd = d2 = 0; }
+  // plane through pt with unit normal n, scaled by weight w
+  quadric(const vect &n, const vect &pt, double w) {
+    double d = -(n.x * pt.x + n.y * pt.y + n.z * pt.z);
+    a2 = w * n.x * n.x; ab = w * n.x * n.y; ac = w * n.x * n.z; ad = w * n.x * d;
+    b2 = w * n.y * n.y; bc = w * n.y * n.z; bd = w * n.y * d;
+    c2 = w * n.z * n.z; cd = w * n.z * d;
+    d2 = w * d * d;
+  }
+  quadric &operator+= (const quadric &q) {
+    a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+    b2 += q.b2; bc += q.bc; bd += q.bd;
+    c2 += q.c2; cd += q.cd;
+    d2 += q.d2;
+    return *this;
+  }
+  double error(const vect &v) const {
+    return a2 * v.x * v.x + 2 * ab * v.x * v.y + 2 * ac * v.x * v.z + 2 * ad * v.x
+         + b2 * v.y * v.y + 2 * bc * v.y * v.z + 2 * bd * v.y
+         + c2 * v.z * v.z + 2 * cd * v.z
+         + d2;
+  }
+  // the point of least error, if the planes pin one down
+  bool optimum(vect &v) const {
+    double det = a2 * (b2 * c2 - bc * bc)
+               - ab * (ab * c2 - bc * ac)
+               + ac * (ab * bc - b2 * ac);
+    double scale = a2 * a2 + b2 * b2 + c2 * c2;
+    if (fabs (det) <= 1e-12 * scale * sqrt (scale)) return false;
+    v.x = -(ad * (b2 * c2 - bc * bc) - ab * (bd * c2 - bc * cd) + ac * (bd * bc - b2 * cd)) / det;
+    v.y = -(a2 * (bd * c2 - cd * bc) - ad * (ab * c2 - bc * ac) + ac * (ab * cd - bd * ac)) / det;
+    v.z = -(a2 * (b2 * cd - bc * bd) - ab * (ab * cd - bd * ac) + ad * (ab * bc - b2 * ac)) / det;
+    return true;
+  }
+};
+
+// candidate edge collapse, ordered so the cheapest is on top
+struct collapse {
+  double cost;
+  unsigned int v1;
+  unsigned int v2;
+  unsigned int stamp1;
+  unsigned int stamp2;
+  vect target;
+  bool operator< (const collapse &c) const {
+    return cost > c.cost;
+  }
+};
+
+static vect faceNormal (const vect &p1, const vect &p2, const vect &p3) {
+  vect e1 = p2 - p1;
+  vect e2 = p3 - p1;
+  return e2 . cross (e1);
+}
+
+static vect faceNormal (const vector <vect> &nodes, const unsigned int *f) {
+  return faceNormal (nodes [f[0]], nodes [f[1]], nodes [f[2]]);
+}
+
+// cheapest place to merge v1 and v2, given their summed quadric.
+// in place, the merged node must sit on one of the two, and the
+// collapse is turned around so that v1 is always the one kept.
+static collapse planCollapse (const vector <vect> &nodes, const vector <quadric> &quads,
+                              const vector <unsigned int> &stamps, bool in_place,
+                              unsigned int v1, unsigned int v2) {
+  quadric q = quads [v1];
+  q += quads [v2];
+
+  collapse c;
+  if (in_place && q . error (nodes [v2]) < q . error (nodes [v1]))
+    swap (v1, v2);
+  c.v1 = v1;
+  c.v2 = v2;
+  c.stamp1 = stamps [v1];
+  c.stamp2 = stamps [v2];
+  if (in_place) {
+    c.target = nodes [v1];
+    c.cost = q . error (c.target);
+    return c;
+  }
+  if (q . optimum (c.target)) {
+    c.cost = q . error (c.target);
+    return c;
+  }
+
+  vect mid ((nodes[v1].x + nodes[v2].x) / 2,
+            (nodes[v1].y + nodes[v2].y) / 2,
+            (nodes[v1].z + nodes[v2].z) / 2);
+  const vect *choice[3] = { &nodes [v1], &nodes [v2], &mid };
+  c.cost = -1;
+  for (int i = 0; i < 3; ++i) {
+    double e = q . error (*choice[i]);
+    if (c.cost < 0 || e < c.cost) {
+      c.cost = e;
+      c.target = *choice[i];
+    }
+  }
+  return c;
+}
+
+// collapsing v2 into v1 must not pinch the surface (the two may only
+// share the neighbours across their common faces) or flip any face
+static bool canCollapse (const vector <vect> &nodes, const vector <unsigned int> &tridx,
+                         const vector <char> &dead, const vector <vector <unsigned int> > &faces,
+                         unsigned int v1, unsigned int v2, const vect &target) {
+  vector <unsigned int> ring1, ring2, opposite;
+  for (int k = 0; k < 2; ++k) {
+    unsigned int v = k ? v2 : v1;
+    vector <unsigned int> &ring = k ? ring2 : ring1;
+    for (int i = 0; i < (int)faces [v] . size (); ++i) {
+      unsigned int f = faces [v] [i];
+      if (dead [f]) continue;
+      const unsigned int *t = &tridx [f * 3];
+      bool has1 = t[0] == v1 || t[1] == v1 || t[2] == v1;
+      bool has2 = t[0] == v2 || t[1] == v2 || t[2] == v2;
+      if (has1 && has2) {
+        for (int j = 0; j < 3; ++j)
+          if (! k && t[j] != v1 && t[j] != v2) opposite . push_back (t[j]);
+        continue;
+      }
+      for (int j = 0; j < 3; ++j)
+        if (t[j] != v) ring . push_back (t[j]);
+
+      // the face keeps its orientation once v moves to the target
+      vect before = faceNormal (nodes, t);
+      vect pts[3];
+      for (int j = 0; j < 3; ++j)
+        pts[j] = t[j] == v ? target : nodes [t[j]];
+      vect after = faceNormal (pts[0], pts[1], pts[2]);
+      double dot = before.x * after.x + before.y * after.y + before.z * after.z;
+      if (dot <= 0.0) return false;
+    }
+  }
+
+  sort (ring1 . begin (), ring1 . end ());
+  ring1 . erase (unique (ring1 . begin (), ring1 . end ()), ring1 . end ());
+  sort (ring2 . begin (), ring2 . end ());
+  ring2 . erase (unique (ring2 . begin (), ring2 . end ()), ring2 . end ());
+  vector <unsigned int> common;
+  set_intersection (ring1 . begin (), ring1 . end (),
+                    ring2 . begin (), ring2 . end (),
+                    back_inserter (common));
+  for (int i = 0; i < (int)common . size (); ++i)
+    if (find (opposite . begin (), opposite . end (), common [i]) == opposite . end ())
+      return false;
+  return true;
+}
+
+// greedy quadric edge collapse over a welded mesh. the quadrics,
+// face lists and candidate queue live here so one mesh can be
+// reduced in steps, taking a snapshot at each node budget. in place,
+// nodes are only ever folded into a neighbour and never moved.
+struct decimator {
+  vector <vect> nodes;
+  vector <unsigned int> tridx;
+  vector <quadric> quads;
+  vector <vector <unsigned int> > faces;
+  vector <char> dead;
+  vector <char> removed;
+  vector <unsigned int> stamps;
+  priority_queue <collapse> heap;
+  int alive;
+  int live_faces;
+  bool in_place;
+
+  decimator(const Mesh &mesh, bool _in_place = false, double crease_degrees = 30.0);
+  void reduce(int max_nodes, int max_faces = 0, double max_cost = -1);
+  void snapshot(Mesh &mesh) const;
+};
+
+decimator::decimator (const Mesh &mesh, bool _in_place, double crease_degrees)
+  : nodes (mesh.nodes, mesh.nodes + mesh.node_count),
+    tridx (mesh.tridx, mesh.tridx + mesh.tri_count * 3),
+    in_place (_in_place) {
+  int node_count = (int)nodes . size ();
+  int tri_count = (int)tridx . size () / 3;
+
+  quads . resize (node_count);
+  faces . resize (node_count);
+  dead . assign (tri_count, 0);
+  removed . assign (node_count, 0);
+  stamps . assign (node_count, 0);
+  vector <vect> normals (tri_count);
+  map <pair <unsigned int, unsigned int>, vector <unsigned int> > edges;
+
+  for (int f = 0; f < tri_count; ++f) {
+    const unsigned int *t = &tridx [f * 3];
+    if (t[0] >= (unsigned int)node_count ||
+        t[1] >= (unsigned int)node_count ||
+        t[2] >= (unsigned int)node_count) {
+      dead [f] = 1;
+      continue;
+    }
+    vect n = faceNormal (nodes, t);
+    double area = n . mag () / 2;
+    normals [f] = n . norm ();
+    quadric q (normals [f], nodes [t[0]], area);
+    for (int j = 0; j < 3; ++j) {
+      quads [t[j]] += q;
+      faces [t[j]] . push_back (f);
+      unsigned int a = t[j];
+      unsigned int b = t[(j + 1) % 3];
+      edges [make_pair (min (a, b), max (a, b))] . push_back (f);
+    }
+  }
+
+  // boundary and crease edges get stiff planes along them, so
+  // collapses that move them cost far more than flat ones
+  double crease_cos = cos (crease_degrees * M_PI / 180.0);
+  map <pair <unsigned int, unsigned int>, vector <unsigned int> >::iterator it;
+  for (it = edges . begin (); it != edges . end (); ++it) {
+    unsigned int a = it -> first . first;
+    unsigned int b = it -> first . second;
+    const vector <unsigned int> &ef = it -> second;
+    const vect &pa = nodes [a];
+    const vect &pb = nodes [b];
+    vect along = pb - pa;
+    double weight = 1000.0 * along . mag_sq ();
+    if (ef . size () == 1) {
+      vect side = along . cross (normals [ef[0]]) . norm ();
+      quadric q (side, nodes [a], weight);
+      quads [a] += q;
+      quads [b] += q;
+    } else if (ef . size () == 2) {
+      const vect &n1 = normals [ef[0]];
+      const vect &n2 = normals [ef[1]];
+      if (n1.x * n2.x + n1.y * n2.y + n1.z * n2.z >= crease_cos) continue;
+      for (int j = 0; j < 2; ++j) {
+        quadric q (normals [ef[j]], nodes [a], weight);
+        quads [a] += q;
+        quads [b] += q;
+      }
+    }
+  }
+
+  alive = 0;
+  for (int i = 0; i < node_count; ++i)
+    if (! faces [i] . empty ()) alive++;
+  live_faces = (int)count (dead . begin (), dead . end (), 0);
+
+  for (it = edges . begin (); it != edges . end (); ++it)
+    heap . push (planCollapse (nodes, quads, stamps, in_place,
+                               it -> first . first, it -> first . second));
+}
+
+// collapse the cheapest edges until at most max_nodes points remain,
+// or at most max_faces triangles if given. with max_cost set, stop at
+// the first collapse that would cost more.
+void decimator::reduce (int max_nodes, int max_faces, double max_cost) {
+  vector <unsigned int> ring;
+  while (alive > max_nodes &&
+         (! max_faces || live_faces > max_faces) &&
+         ! heap . empty ()) {
+    collapse c = heap . top ();
+    unsigned int v1 = c.v1;
+    unsigned int v2 = c.v2;
+    if (removed [v1] || removed [v2] ||
+        c.stamp1 != stamps [v1] || c.stamp2 != stamps [v2]) {
+      heap . pop ();
+      continue;
+    }
+    if (max_cost >= 0 && c.cost > max_cost) break;
+    heap . pop ();
+    if (! canCollapse (nodes, tridx, dead, faces, v1, v2, c.target)) continue;
+
+    // fold v2 into v1
+    nodes [v1] = c.target;
+    quads [v1] += quads [v2];
+    removed [v2] = 1;
+    stamps [v1]++;
+    alive--;
+    for (int i = 0; i < (int)faces [v2] . size (); ++i) {
+      unsigned int f = faces [v2] [i];
+      if (dead [f]) continue;
+      unsigned int *t = &tridx [f * 3];
+      if (t[0] == v1 || t[1] == v1 || t[2] == v1) {
+        dead [f] = 1;
+        live_faces--;
+        continue;
+      }
+      for (int j = 0; j < 3; ++j)
+        if (t[j] == v2) t[j] = v1;
+      faces [v1] . push_back (f);
+    }
+    faces [v2] . clear ();
+
+    // drop the dead faces from v1 and re-plan its edges
+    ring . clear ();
+    vector <unsigned int> &f1 = faces [v1];
+    int kept = 0;
+    for (int i = 0; i < (int)f1 . size (); ++i) {
+      if (dead [f1 [i]]) continue;
+      f1 [kept++] = f1 [i];
+      const unsigned int *t = &tridx [f1 [i] * 3];
+      for (int j = 0; j < 3; ++j)
+        if (t[j] != v1) ring . push_back (t[j]);
+    }
+    f1 . resize (kept);
+    sort (ring . begin (), ring . end ());
+    ring . erase (unique (ring . begin (), ring . end ()), ring . end ());
+    for (int i = 0; i < (int)ring . size (); ++i)
+      heap . push (planCollapse (nodes, quads, stamps, in_place, v1, ring [i]));
+  }
+}
+
+// pack the surviving nodes and faces back into the mesh
+void decimator::snapshot (Mesh &mesh) const {
+  int node_count = (int)nodes . size ();
+  int tri_count = (int)tridx . size () / 3;
+  vector <unsigned int> remap (node_count, (unsigned int)-1);
+  mesh.node_count = 0;
+  mesh.tri_count = 0;
+  for (int f = 0; f < tri_count; ++f) {
+    if (dead [f]) continue;
+    unsigned int *t = &mesh.tridx [mesh.tri_count++ * 3];
+    for (int j = 0; j < 3; ++j) {
+      unsigned int v = tridx [f * 3 + j];
+      if (remap [v] == (unsigned int)-1) {
+        remap [v] = mesh.node_count;
+        mesh.nodes [mesh.node_count++] = nodes [v];
+      }
+      t[j] = remap [v];
+    }
+  }
+}
+
+// collapse the cheapest edges by quadric error until at most max_nodes
+// points remain. stiff planes keep the open boundary and sharp creases
+// until the budget leaves nothing cheaper to collapse
+void decimateNodes (Mesh &mesh, int max_nodes, double crease_degrees) {
+  int node_count = mesh.node_count;
+  int tri_count = mesh.tri_count;
+
+  decimator d (mesh, false, crease_degrees);
+  d . reduce (max_nodes);
+  d . snapshot (mesh);
+
+  LOG (mesh.verbosity, LOG_NORMAL, "decimated %d nodes into %d, %d triangles into %d\n",
+           node_count, mesh.node_count, tri_count, mesh.tri_count);
+}
+
+// surface triangles for the jbeam collision section. flat regions
+// are merged by folding nodes into a neighbour, so every corner is
+// still a jbeam node, then the cheapest folds carry on down to the
+// triangle budget (0 only merges the flat regions)
+void collisionTriangles (Mesh &mesh, int budget, double crease_degrees) {
+  // "flat" is relative to the size of the surface, the error of a
+  // fold grows with area squared times distance squared
+  double area = 0;
+  for (int f = 0; f < mesh.tri_count; ++f) {
+    const unsigned int *t = &mesh.tridx [f * 3];
+    area += faceNormal (mesh.nodes [t[0]], mesh.nodes [t[1]], mesh.nodes [t[2]]) . mag () / 2;
+  }
+
+  decimator d (mesh, true, crease_degrees);
+  d . reduce (0, 0, 1e-12 * area * area);
+  if (budget)
+    d . reduce (0, budget);
+
+  mesh.collision_count = 0;
+  for (int f = 0; f < mesh.tri_count; ++f) {
+    if (d.dead [f]) continue;
+    unsigned int *t = &mesh.collision [mesh.collision_count++ * 3];
+    for (int j = 0; j < 3; ++j)
+      t[j] = d.tridx [f * 3 + j];
+  }
+
+  LOG (mesh.verbosity, LOG_NORMAL, "merged %d collision triangles into %d\n", mesh.tri_count, mesh.collision_count);
+}
+
+// spread the low 21 bits of v so there are two zero bits between each
+static unsigned long long mortonSpread (unsigned long long v) {
+  v &= 0x1fffffULL;
+  v = (v | (v << 32)) & 0x1f00000000ffffULL;
+  v = (v | (v << 16)) & 0x1f0000ff0000ffULL;
+  v = (v | (v << 8))  & 0x100f00f00f00f00fULL;
+  v = (v | (v << 4))  & 0x10c30c30c30c30c3ULL;
+  v = (v | (v << 2))  & 0x1249249249249249ULL;
+  return v;
+}
+
+// node order along a z-order curve through the bounding box
+vector <unsigned int> mortonOrder (const vect *nodes, int node_count) {
+  vector <unsigned int> order;
+  if (! node_count) return order;
+
+  vect lo = nodes [0];
+  vect hi = nodes [0];
+  for (int i = 1; i < node_count; ++i) {
+    const vect &n = nodes [i];
+    lo . set (min (lo.x, n.x), min (lo.y, n.y), min (lo.z, n.z));
+    hi . set (max (hi.x, n.x), max (hi.y, n.y), max (hi.z, n.z));
+  }
+  double extent = max (hi.x - lo.x, max (hi.y - lo.y, hi.z - lo.z));
+  double scale = extent > 0.0 ? 2097151.0 / extent : 0.0;
+
+  vector <pair <unsigned long long, unsigned int> > keyed (node_count);
+  for (int i = 0; i < node_count; ++i) {
+    const vect &n = nodes [i];
+    unsigned long long code =
+        mortonSpread ((unsigned long long)((n.x - lo.x) * scale))
+      | mortonSpread ((unsigned long long)((n.y - lo.y) * scale)) << 1
+      | mortonSpread ((unsigned long long)((n.z - lo.z) * scale)) << 2;
+    keyed [i] = make_pair (code, (unsigned int)i);
+  }
+  sort (keyed . begin (), keyed . end ());
+
+  order . resize (node_count);
+  for (int i = 0; i < node_count; ++i)
+    order [i] = keyed [i] . second;
+  return order;
+}
+
+// reverse cuthill-mckee over the beam graph, which keeps the
+// two ends of every beam close together in the node numbering
+vector <unsigned int> rcmOrder (const Mesh &mesh) {
+  int node_count = mesh.node_count;
+
+  vector <vector <unsigned int> > adj (node_count);
+  for (int i = 0; i < mesh.beam_count; ++i) {
+    const edge &b = mesh.beams [i];
+    adj [b.n1] . push_back (b.n2);
+    adj [b.n2] . push_back (b.n1);
+  }
+
+  vector <pair <unsigned int, unsigned int> > by_degree (node_count);
+  for (int i = 0; i < node_count; ++i)
+    by_degree [i] = make_pair ((unsigned int)adj [i] . size (), (unsigned int)i);
+  sort (by_degree . begin (), by_degree . end ());
+
+  vector <unsigned int> order;
+  order . reserve (node_count);
+  vector <char> visited (node_count, 0);
+  vector <pair <unsigned int, unsigned int> > next;
+
+  // start each connected piece from its lowest degree node
+  for (int s = 0; s < node_count; ++s) {
+    unsigned int start = by_degree [s] . second;
+    if (visited [start]) continue;
+    visited [start] = 1;
+
+    size_t head = order . size ();
+    order . push_back (start);
+    while (head < order . size ()) {
+      unsigned int n = order [head++];
+      next . clear ();
+      for (int j = 0; j < (int)adj [n] . size (); ++j) {
+        unsigned int m = adj [n] [j];
+        if (visited [m]) continue;
+        visited [m] = 1;
+        next . push_back (make_pair ((unsigned int)adj [m] . size (), m));
+      }
+      sort (next . begin (), next . end ());
+      for (int j = 0; j < (int)next . size (); ++j)
+        order . push_back (next [j] . second);
+    }
+  }
+
+  reverse (order . begin (), order . end ());
+  return order;
+}
+
+// renumber the nodes for memory locality, then sort the beams
+// by their renumbered end points
+bool reorderNodes (Mesh &mesh, const string &how) {
+  vector <unsigned int> order;
+  if (how == "morton")
+    order = mortonOrder (mesh.nodes, mesh.node_count);
+  else if (how == "rcm")
+    order = rcmOrder (mesh);
+  else
+    return false;
+
+  int node_count = mesh.node_count;
+  vector <vect> moved (mesh.nodes, mesh.nodes + node_count);
+  vector <unsigned int> index (node_count);
+  for (int i = 0; i < node_count; ++i) {
+    mesh.nodes [i] = moved [order [i]];
+    index [order [i]] = i;
+  }
+
+  for (int i = 0; i < mesh.tri_count * 3; ++i)
+    mesh.tridx [i] = index [mesh.tridx [i]];
+  for (int i = 0; i < mesh.collision_count * 3; ++i)
+    mesh.collision [i] = index [mesh.collision [i]];
+
+  int bs = mesh.beam_count;
+  for (int i = 0; i < bs; ++i) {
+    edge &b = mesh.beams [i];
+    unsigned int i1 = index [b.n1];
+    unsigned int i2 = index [b.n2];
+    b.n1 = min (i1, i2);
+    b.n2 = max (i1, i2);
+  }
+  sort (mesh.beams, mesh.beams + bs);
+
+  LOG (mesh.verbosity, LOG_NORMAL, "reordered %d nodes and %d beams by %s\n", node_count, bs, how . c_str ());
+  return true;
+}
+
+// a whole file, or false if it cannot be read
+static bool readFile (const string &path, string &text) {
+  FILE *fp = fopen (path . c_str (), "rb");
+  if (! fp) return false;
+  char buf[65536];
+  size_t got;
+  text . clear ();
+  while ((got = fread (buf, 1, sizeof (buf), fp)) > 0)
+    text . append (buf, got);
+  bool ok = ! ferror (fp);
+  fclose (fp);
+  return ok;
+}
+
+int compareExport (const string &dir, const string &expected,
+                   const string &model, int verbosity) {
+  const char *names[] = { ".jbeam", "info.json", "material.cs" };
+  string at = dir . empty () ? string () : dir + "/";
+
+  int status = SKETCHER_OK;
+  for (int i = 0; i < 3; ++i) {
+    string name = i ? string (names [i]) : model + names [i];
+    string got, want;
+    if (! readFile (at + name, got)) {
+      printf ("unable to read %s\n", (at + name) . c_str ());
+      status = SKETCHER_MISMATCH;
+      continue;
+    }
+    if (! readFile (expected + "/" + name, want)) {
+      printf ("unable to read %s\n", (expected + "/" + name) . c_str ());
+      status = SKETCHER_MISMATCH;
+      continue;
+    }
+    if (got == want) {
+      LOG (verbosity, LOG_VERBOSE, "%s matches\n", name . c_str ());
+      continue;
+    }
+
+    size_t same = mismatch (got . begin (), got . begin () + min (got . size (), want . size ()),
+                            want . begin ()) . first - got . begin ();
+    int line = 1 + (int)count (got . begin (), got . begin () + same, '\n');
+    printf ("%s differs from %s/%s at line %d\n",
+            (at + name) . c_str (), expected . c_str (), name . c_str (), line);
+    status = SKETCHER_MISMATCH;
+  }
+  return status;
+}
+
+vector <unsigned int> UintSplit (string str, const char *delim) {
+  vector <unsigned int> tokens;
+  int len = str.length ();
+  char *cstr = new char[len + 1];
+  if (! cstr) return tokens;
+  strncpy (cstr, str.c_str(), len);
+  cstr[len] = 0;
+  char *buf = cstr;
+  char *save;
+  while (char *got = strtok_r (buf, delim, &save))
+   { tokens . push_back ((unsigned int)strtoul (got, NULL, 0));
+     buf = NULL;
+   }
+  delete [] (cstr);
+  return tokens;
+}
+
+vector <double> DoubleSplit (string str, const char *delim) {
+  vector <double> tokens;
+  int len = str.length ();
+  char *cstr = new char[len + 1];
+  if (! cstr) return tokens;
+  strncpy (cstr, str.c_str(), len);
+  cstr[len] = 0;
+  char *buf = cstr;
+  char *save;
+  while (char *got = strtok_r (buf, delim, &save))
+   { tokens . push_back (strtod (got, NULL));
+     buf = NULL;
+   }
+  delete [] (cstr);
+  return tokens;
+}
+
+// below this much text the tokenizing is not worth handing out
+#define SPLIT_CHUNK (1 << 20)
+
+template <class T> struct splitChunk {
+  const char *text;
+  size_t len;
+  vector <T> (*split)(string, const char *);
+  vector <T> tokens;
+};
+
+template <class T> static void splitPiece (void *arg) {
+  splitChunk <T> *c = (splitChunk <T> *)arg;
+  c -> tokens = c -> split (string (c -> text, c -> len), " ");
+}
+
+// split(text, " "), with the text cut at spaces into pieces that the
+// pool's threads tokenize side by side
+template <class T>
+static vector <T> splitText (taskPool *pool, const char *text,
+                             vector <T> (*split)(string, const char *)) {
+  size_t len = strlen (text);
+  if (! pool || len < 2 * SPLIT_CHUNK) return split (text, " ");
+
+  vector <splitChunk <T> > chunks;
+  for (size_t at = 0; at < len; ) {
+    size_t end = min (len, at + SPLIT_CHUNK);
+    while (end < len && text [end] != ' ') ++end;
+    splitChunk <T> c;
+    c.text = text + at;
+    c.len = end - at;
+    c.split = split;
+    chunks . push_back (c);
+    at = end;
+  }
+
+  taskGroup group;
+  for (size_t i = 0; i < chunks . size (); ++i)
+    pool -> spawn (group, splitPiece <T>, &chunks [i]);
+  pool -> wait (group);
+
+  size_t total = 0;
+  for (size_t i = 0; i < chunks . size (); ++i)
+    total += chunks [i] . tokens . size ();
+  vector <T> tokens;
+  tokens . reserve (total);
+  for (size_t i = 0; i < chunks . size (); ++i)
+    tokens . insert (tokens . end (), chunks [i] . tokens . begin (), chunks [i] . tokens . end ());
+  return tokens;
+}
+
+// the numbers in text[0..len), as split counts them
+static size_t countTokens (const char *text, size_t len) {
+  size_t count = 0;
+  for (size_t i = 0; i < len; ++i)
+    if (text [i] != ' ' && (! i || text [i - 1] == ' '))
+      count++;
+  return count;
+}
+
+// splitText for a text that was split before into last_tokens. the
+// bytes both texts start with and end with, cut back to a space, hold
+// the same numbers as before, so only the part between is tokenized.
+// same gets how many of the first numbers were taken over, and fresh
+// how many were tokenized.
+template <class T>
+static vector <T> splitAgain (taskPool *pool, const char *text,
+                              vector <T> (*split)(string, const char *),
+                              const string &last, const vector <T> &last_tokens,
+                              size_t &same, size_t &fresh) {
+  size_t len = strlen (text);
+  size_t last_len = last . size ();
+  same = 0;
+  fresh = 0;
+  if (! last_len) {
+    vector <T> tokens = splitText (pool, text, split);
+    fresh = tokens . size ();
+    return tokens;
+  }
+
+  size_t most = min (len, last_len);
+  size_t head = mismatch (text, text + most, last . data ()) . first - text;
+  if (head == len && len == last_len) {
+    same = last_tokens . size ();
+    return last_tokens;
+  }
+  while (head && text [head - 1] != ' ') --head;
+  size_t tail = 0;
+  while (tail < most - head && text [len - 1 - tail] == last [last_len - 1 - tail]) ++tail;
+  while (tail && text [len - tail] != ' ') --tail;
+
+  size_t before = countTokens (text, head);
+  size_t after = countTokens (text + len - tail, tail);
+  if (before + after > last_tokens . size ()) {
+    vector <T> tokens = splitText (pool, text, split);
+    fresh = tokens . size ();
+    return tokens;
+  }
+
+  string changed (text + head, len - tail - head);
+  vector <T> middle = splitText (pool, changed . c_str (), split);
+  vector <T> tokens;
+  tokens . reserve (before + middle . size () + after);
+  tokens . insert (tokens . end (), last_tokens . begin (), last_tokens . begin () + before);
+  tokens . insert (tokens . end (), middle . begin (), middle . end ());
+  tokens . insert (tokens . end (), last_tokens . end () - after, last_tokens . end ());
+  same = before;
+  fresh = middle . size ();
+  return tokens;
+}
+
+XMLElement *FindElement (XMLElement *parent,
+                         vector <string> hierarchy,
+                         const char *attr = NULL,
+                         const char *named = NULL) {
+  if (! parent) return NULL;
+  int elems = hierarchy . size ();
+  if (! elems) return NULL;
+  XMLElement *it = parent;
+  for (int i = 0; i < elems; ++i) {
+    XMLElement *buf = it -> FirstChildElement (hierarchy [i] . c_str());
+    if (! buf)
+      return NULL;
+    if (attr && named && strcmp (buf -> Attribute(attr), named))
+      return NULL;
+    it = buf;
+  }
+  return it;
+}
+
+string lower (string s) {
+  transform(s.begin(), s.end(), s.begin(), ::tolower);
+  return s;
+}
+
+// rows per piece when a pool formats the nodes or beams
+#define FORMAT_CHUNK 65536
+
+struct formatChunk {
+  const vect *nodes;
+  const edge *beams;
+  const unsigned int *ids;
+  int from;
+  int to;
+  char pfx;
+  int first;
+  string text;
+};
+
+// the id node n is written with, its index unless renamed
+static inline unsigned int nodeId (const unsigned int *ids, unsigned int n) {
+  return ids ? ids [n] : n;
+}
+
+static void formatNodes (void *arg) {
+  formatChunk *c = (formatChunk *)arg;
+  char line[1024];    // three of the widest doubles
+  for (int i = c -> from; i < c -> to; ++i) {
+    const vect &n = c -> nodes [i];
+    int len = snprintf (line, sizeof (line), "        [\"%c%u\",%0.3f,%0.3f,%0.3f],\n",
+                        c -> pfx, nodeId (c -> ids, c -> first + i), n.x, n.y, n.z);
+    c -> text . append (line, min (len, (int)sizeof (line) - 1));
+  }
+}
+
+static void formatBeams (void *arg) {
+  formatChunk *c = (formatChunk *)arg;
+  char line[64];
+  for (int i = c -> from; i < c -> to; ++i) {
+    const edge &b = c -> beams [i];
+    int len = snprintf (line, sizeof (line), "        [\"%c%u\",\"%c%u\"],\n",
+                        c -> pfx, nodeId (c -> ids, b.n1), c -> pfx, nodeId (c -> ids, b.n2));
+    c -> text . append (line, len);
+  }
+}
+
+// format count rows in pieces on the pool's threads, then write them
+// in order
+static void writeChunks (FILE *fp, taskPool *pool, const formatChunk &like, int count,
+                         void (*format)(void *)) {
+  vector <formatChunk> chunks;
+  for (int at = 0; at < count; at += FORMAT_CHUNK) {
+    chunks . push_back (like);
+    chunks . back () . from = at;
+    chunks . back () . to = min (count, at + FORMAT_CHUNK);
+  }
+
+  taskGroup group;
+  for (size_t i = 0; i < chunks . size (); ++i)
+    pool -> spawn (group, format, &chunks [i]);
+  pool -> wait (group);
+
+  for (size_t i = 0; i < chunks . size (); ++i)
+    fwrite (chunks [i] . text . data (), 1, chunks [i] . text . size (), fp);
+}
+
+// nodes first to first + ns, named by ids when given
+void writeNodes (FILE *fp, const vect *nodes, int ns, const string &group, const char pfx,
+                 int first = 0, taskPool *pool = NULL, const unsigned int *ids = NULL) {
+  if (! fp) return;
+  if (! ns) return;
+  fprintf (fp, "        {\"group\":\"%s\"},\n",
+                group.c_str());
+
+  if (pool && ns > FORMAT_CHUNK) {
+    formatChunk like;
+    like.nodes = nodes;
+    like.beams = NULL;
+    like.ids = ids;
+    like.pfx = pfx;
+    like.first = first;
+    writeChunks (fp, pool, like, ns, formatNodes);
+    return;
+  }
+
+  for (int i = 0; i < ns; ++i) {
+      const vect &n = nodes [i];
+      fprintf (fp, "        [\"%c%u\",%0.3f,%0.3f,%0.3f],\n", pfx, nodeId (ids, first + i), n.x, n.y, n.z);
+  }
+
+}
+
+void writeBeamProperties (FILE *fp, unsigned int spring, unsigned int damp,
+                          unsigned int deform, unsigned int strength) {
+  string def = "FLT_MAX";
+  if (deform) {
+      ostringstream convert;
+      convert << deform;
+      def = convert.str();
+  }
+
+  string strn = "FLT_MAX";
+  if (strength) {
+      ostringstream convert;
+      convert << strength;
+      strn = convert.str();
+  }
+
+  fprintf (fp, "        {\"beamSpring\":%u,\"beamDamp\":%u},\n"
+               "        {\"beamDeform\":\"%s\",\"beamStrength\":\"%s\"},\n",
+               spring,
+               damp,
+               def.c_str(),
+               strn.c_str()
+          );
+}
+
+// beams within one node group, by node index
+void writeBeams (FILE *fp, const edge *beams, int bs, const char pfx,
+                 unsigned int spring, unsigned int damp,
+                 unsigned int deform = 0, unsigned int strength = 0,
+                 taskPool *pool = NULL, const unsigned int *ids = NULL)
+{ if (! fp) return;
+  if (! bs) return;
+
+  writeBeamProperties (fp, spring, damp, deform, strength);
+
+  if (pool && bs > FORMAT_CHUNK) {
+    formatChunk like;
+    like.nodes = NULL;
+    like.beams = beams;
+    like.ids = ids;
+    like.pfx = pfx;
+    like.first = 0;
+    writeChunks (fp, pool, like, bs, formatBeams);
+    return;
+  }
+
+  for (int i = 0; i < bs; ++i) {
+      const edge &b = beams [i];
+      fprintf(fp, "        [\"%c%u\",\"%c%u\"],\n", pfx, nodeId (ids, b.n1), pfx, nodeId (ids, b.n2));
+  }
+}
+
+// beams spilled to disk by extractBeamsExternal
+void writeBeams (FILE *fp, FILE *spill, int bs, const char pfx,
+                 unsigned int spring, unsigned int damp,
+                 unsigned int deform = 0, unsigned int strength = 0,
+                 const unsigned int *ids = NULL)
+{ if (! fp || ! spill) return;
+  if (! bs) return;
+
+  writeBeamProperties (fp, spring, damp, deform, strength);
+
+  rewind (spill);
+  edge chunk[4096];
+  size_t got;
+  while ((got = fread (chunk, sizeof (edge), 4096, spill)) > 0)
+    for (size_t i = 0; i < got; ++i)
+      fprintf(fp, "        [\"%c%u\",\"%c%u\"],\n", pfx, nodeId (ids, chunk[i].n1),
+              pfx, nodeId (ids, chunk[i].n2));
+}
+
+// beams between two node groups, found by position
+void writeBeams (FILE *fp, const vector <beam> &beams,
+                 const vect *first, int first_count, const char first_char,
+                 const vector <vect> &second, const char second_char,
+                 unsigned int spring, unsigned int damp,
+                 unsigned int deform = 0, unsigned int strength = 0,
+                 const unsigned int *first_ids = NULL)
+{ if (! fp) return;
+  int bs = (int)beams . size ();
+  if (! bs) return;
+
+  writeBeamProperties (fp, spring, damp, deform, strength);
+
+  for (int i = 0; i < bs; ++i) {
+      const beam &b = beams [i];
+      const vect &p1 = b.p1;
+      const vect &p2 = b.p2;
+
+      int i1 = 0;
+      char i1_set = 0;
+
+      int i2 = 0;
+      char i2_set = 0;
+
+      for (int j = 0; j < first_count; ++j) {
+        const vect &n = first [j];
+        if (n == p1) { i1 = nodeId (first_ids, j); i1_set = first_char; }
+        if (n == p2) { i2 = nodeId (first_ids, j); i2_set = first_char; }
+      }
+
+      for (int j = 0; j < second . size (); ++j) {
+        const vect &n = second [j];
+        if (! i1_set && n == p1) { i1 = j; i1_set = second_char; }
+        if (! i2_set && n == p2) { i2 = j; i2_set = second_char; }
+      }
+
+      fprintf(fp, "        [\"%c%d\",\"%c%d\"],\n", i1_set, i1, i2_set, i2);
+  }
+}
+
+void writeTriangles (FILE *fp, const unsigned int *tridx, int ts, const char pfx,
+                     const unsigned int *ids = NULL) {
+  if (! fp) return;
+  if (! ts) return;
+
+  for (int i = 0; i < ts; ++i) {
+    const unsigned int *t = &tridx [i * 3];
+    fprintf (fp, "        [\"%c%u\",\"%c%u\",\"%c%u\"],\n",
+                 pfx, nodeId (ids, t[0]), pfx, nodeId (ids, t[1]), pfx, nodeId (ids, t[2]));
+  }
+}
+
+void writeMaterial (FILE *mat, const string &body) {
+  if (! mat) return;
+
+  string pic = body + ".png";
+
+  fprintf (mat, "singleton Material(%s)\n"
+                "{\n"
+                "    mapTo = \"%s\";\n"
+                "    diffuseMap[0] = \"%s\";\n"
+                "    specularPower[0] = \"15\";\n"
+                "    useAnisotropic[0] = \"1\";\n"
+                "    castShadows = \"1\";\n"
+                "    translucent = \"0\";\n"
+                "    alphaTest = \"0\";\n"
+                "    alphaRef = \"0\";\n"
+                "}\n",
+                body . c_str(),
+                body . c_str(),
+                pic . c_str()
+          );
+}
+
+// the jbeam itself, to any stream
+bool writeJBeam (FILE *fp, const Converter &conv,
+                 const string &author, const string &model, const Mesh &mesh,
+                 const vector <vect> &axle_nodes, const vector <beam> &axle_beams,
+                 const vector <beam> &steering_beams) {
+  if (! fp) return false;
+
+  // body naming
+  string body = model + "_body";
+  string body_group = lower (body + "_g");
+  char body_char = 'b';
+
+  // one group per surface when they were split
+  vector <string> body_groups;
+  for (int k = 0; k < mesh.group_count; ++k) {
+    ostringstream name;
+    name << body << "_" << k << "_g";
+    body_groups . push_back (lower (name . str ()));
+  }
+  if (body_groups . empty ())
+    body_groups . push_back (body_group);
+  string flex_groups;
+  for (int k = 0; k < (int)body_groups . size (); ++k)
+    flex_groups += (k ? ", \"" : "\"") + body_groups [k] + "\"";
+
+  // axle naming
+  string axles = model + "_axles";
+  string axles_group = lower (axles + "_g");
+  char axle_char = 'a';
+
+  // wheel naming
+  string wbase = "Wheel";
+
+  string wheel_fl = wbase + "_FL";
+  string wheel_fr = wbase + "_FR";
+  string wheel_rl = wbase + "_RL";
+  string wheel_rr = wbase + "_RR";
+
+  string wheel_fl_group = lower (wheel_fl + "_g");
+  string wheel_fr_group = lower (wheel_fr + "_g");
+  string wheel_rl_group = lower (wheel_rl + "_g");
+  string wheel_rr_group = lower (wheel_rr + "_g");
+
+  // header
+  fprintf (fp, "{\"%s\":\n"
+               "\n"
+               "{\n"
+               "    \"information\":{\n"
+               "         \"authors\":\"%s\",\n"
+               "         \"name\":\"%s\",\n"
+               "    }\n"
+               "\n"
+               "    \"slotType\" : \"main\",\n"
+               "\n"
+               "    \"flexbodies\": [\n"
+               "        [\"mesh\", \"[group]:\", \"nonFlexMaterials\"],\n"
+               "        [\"%s\", [%s]],\n"
+               "        [\"%s\", [\"%s\"]],\n"
+               "        [\"%s\", [\"%s\"]],\n"
+               "        [\"%s\", [\"%s\"]],\n"
+               "        [\"%s\", [\"%s\"]],\n"
+               "    ],\n"
+               "\n",
+                model.c_str(),
+                author.c_str(),
+                model.c_str(),
+                body.c_str(),
+                flex_groups.c_str(),
+                wheel_fl.c_str(),
+                wheel_fl_group.c_str(),
+                wheel_fr.c_str(),
+                wheel_fr_group.c_str(),
+                wheel_rl.c_str(),
+                wheel_rl_group.c_str(),
+                wheel_rr.c_str(),
+                wheel_rr_group.c_str()
+          );
+
+  // nodes
+  fprintf (fp, "    \"nodes\": [\n"
+               "        [\"id\", \"posX\", \"posY\", \"posZ\"],\n"
+               "        {\"nodeWeight\":%u},\n"
+               "        {\"frictionCoef\":%0.2f},\n"
+               "        {\"nodeMaterial\":\"|NM_METAL\"},\n"
+               "        {\"collision\":true},\n"
+               "        {\"selfCollision\":true},\n",
+               conv.node_weight,
+               conv.coef_friction);
+
+  // kept from the last run, if any, else the node indices
+  const unsigned int *ids = mesh.ids . empty () ? NULL : &mesh.ids [0];
+  for (int k = 0; k < (int)body_groups . size (); ++k) {
+    int first = mesh.group_count ? mesh.groups [k] : 0;
+    int last = k + 1 < mesh.group_count ? mesh.groups [k + 1] : mesh.node_count;
+    writeNodes (fp, mesh.nodes + first, last - first, body_groups [k], 'b', first, conv.pool, ids);
+  }
+  writeNodes (fp, axle_nodes . data (), (int)axle_nodes . size (), axles_group, 'a');
+
+  fprintf (fp, "    ],\n"
+               "\n");
+
+  // beams
+  fprintf (fp, "    \"beams\": [\n"
+               "        [\"id1:\", \"id2:\"],\n");
+
+  if (mesh.spill)
+    writeBeams (fp, mesh.spill, mesh.spill_count, body_char,
+                conv.spring, conv.damp, conv.deform, conv.strength, ids);
+  else
+    writeBeams (fp, mesh.beams, mesh.beam_count, body_char,
+                conv.spring, conv.damp, conv.deform, conv.strength, conv.pool, ids);
+  writeBeams (fp, axle_beams, mesh.nodes, mesh.node_count, body_char, axle_nodes, axle_char,
+              conv.spring, conv.damp, 0, 0, ids);
+
+  fprintf (fp, "    ],\n"
+               "\n");
+
+  // collision triangles
+  if (mesh.collision_count) {
+    fprintf (fp, "    \"triangles\": [\n"
+                 "        [\"id1:\", \"id2:\", \"id3:\"],\n");
+
+    writeTriangles (fp, mesh.collision, mesh.collision_count, body_char, ids);
+
+    fprintf (fp, "    ],\n"
+                 "\n");
+  }
+
+  // steering hydros
+  fprintf (fp, "    \"hydros\": [\n"
+               "        [\"id1:\", \"id2:\"],\n");
+
+  for (int i = 0; i < steering_beams . size (); ++i) {
+    const beam &b = steering_beams [i];
+    const vect &p1 = b.p1;
+    const vect &p2 = b.p2;
+    int i1 = 0;
+    int i2 = 0;
+    for (int j = 0; j < axle_nodes . size (); ++j) {
+      const vect &n = axle_nodes [j];
+      if (n == p1) i1 = j;
+      if (n == p2) i2 = j;
+    }
+    fprintf (fp, "        [\"%c%d\",\"%c%d\",{\"factor\":%0.2f,\"steeringWheelLock\":%u,\"lockDegrees\":%u}],\n",
+                 axle_char,
+                 i1,
+                 axle_char,
+                 i2,
+                 conv.wheel_factor,
+                 conv.wheel_lock,
+                 conv.wheel_degrees);
+  }
+
+  fprintf (fp, "    ],\n"
+               "\n");
+
+  // TODO: write "hubWheels"
+  // TODO: write "enginetorque"
+  // TODO: write "engine"
+
+  // footer
+  fprintf (fp, "}\n");
+  fprintf (fp, "}\n");
+
+  return ! ferror (fp);
+}
+
+bool exportJBeam (const Converter &conv, const string &dir,
+                  const string &author, const string &model, const Mesh &mesh,
+                  const vector <vect> &axle_nodes, const vector <beam> &axle_beams,
+                  const vector <beam> &steering_beams) {
+
+  string at = dir . empty () ? "" : dir + "/";
+  string jbeam = at + model + ".jbeam";
+
+  // jbeam file
+  FILE *fp = fopen (jbeam . c_str (), "w");
+  if (! fp) return false;
+  bool wrote;
+  {
+    traceSpan span (conv.trace, "serialize", mesh.source);
+    wrote = writeJBeam (fp, conv, author, model, mesh,
+                        axle_nodes, axle_beams, steering_beams);
+  }
+  traceSpan span (conv.trace, "write", mesh.source);
+  fclose (fp);
+  if (! wrote) return false;
+
+  string body = model + "_body";
+  string wheel = model + "_wheel";
+
+  // info file
+  FILE *info = fopen ((at + "info.json") . c_str (), "w");
+  if (! info) return false;
+
+  fprintf (info, "{\n"
+                 "    \"Name\":\"%s\",\n"
+                 "    \"Author\":\"%s\",\n"
+                 "    \"Type\":\"Car\",\n"
+                 "    \"default_pc\":\"default\",\n"
+                 "    \"colors\":{\n"
+                 "        \"Pearl White\": \"1 1 1 1\"\n"
+                 "    }\n"
+                 "}\n",
+                 model . c_str(),
+                 author . c_str()
+          );
+
+  fclose (info);
+
+  // material file
+  FILE *mat = fopen ((at + "material.cs") . c_str (), "w");
+  if (! mat) return false;
+
+  writeMaterial (mat, body);
+  fprintf (mat, "\n");
+  writeMaterial (mat, wheel);
+
+  fclose (mat);
+
+  return true;
+}
+
+
+Converter::Converter () {
+  node_weight = 10;
+  coef_friction = 0.7;
+  spring = 2000000;
+  damp = 200;
+  deform = 80000;
+  strength = 800000;
+  wheel_factor = 0.05;
+  wheel_lock = 460;
+  wheel_degrees = 25;
+  crease_degrees = 30.0;
+
+  max_nodes = 0;
+  margin = -1;
+  collision = -1;
+  mem_limit = 0;
+  split = -1;
+  max_triangles = 0;
+  pipeline = false;
+  verbosity = LOG_NORMAL;
+  trace = NULL;
+  pool = NULL;
+  state = NULL;
+}
+
+bool Converter::valid () const {
+  if (max_nodes < 0 || margin > 1 || mem_limit < 0 || max_triangles < 0)
+    return false;
+  if (max_nodes && ! lods . empty ())
+    return false;
+  // only the on-disk path streams between its stages
+  if (pipeline && ! mem_limit)
+    return false;
+  if (find (lods . begin (), lods . end (), 0u) != lods . end ())
+    return false;
+  if (! (order . empty () || order == "morton" || order == "rcm"))
+    return false;
+  // the on-disk path never holds the whole mesh, which the rest need
+  if (mem_limit && (max_nodes || ! lods . empty () || margin >= 0 ||
+                    collision >= 0 || ! order . empty () || split >= 0))
+    return false;
+  // the decimator keeps working on the joined mesh between levels
+  if (split >= 0 && ! lods . empty ())
+    return false;
+  return true;
+}
+
+#define FNV_OFFSET 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+// fnv-1a, carried on from h
+static unsigned long long hashText (unsigned long long h, const char *text) {
+  for (const unsigned char *p = (const unsigned char *)text; *p; ++p)
+    h = (h ^ *p) * FNV_PRIME;
+  return h;
+}
+
+// the nodes and triangles of a loaded collada document, for parse
+// and parseBuffer
+static int readCollada (const Converter &conv, XMLDocument &doc, Mesh &mesh) {
+  mesh.verbosity = conv.verbosity;
+
+  XMLElement *collada = doc.FirstChildElement("COLLADA");
+  if (! collada) {
+    printf ("unable to find the COLLADA XML element\n");
+    return SKETCHER_NO_COLLADA;
+  }
+
+  // search for the mesh
+  vector <string> mh;
+  mh . push_back ("library_geometries");
+  mh . push_back ("geometry");
+  mh . push_back ("mesh");
+  XMLElement *geom = FindElement (collada, mh);
+  if (! geom) {
+    printf ("unable to find the mesh\n");
+    return SKETCHER_NO_MESH;
+  }
+
+  // find the first set of sources, which are the node dimensions
+  vector <string> fh;
+  fh . push_back ("source");
+  fh . push_back ("float_array");
+  XMLElement *fa = FindElement (geom, fh);
+  if (! fa) {
+    printf ("unable to find the float_array XML element\n");
+    return SKETCHER_NO_NODES;
+  }
+
+  // find the first set of triangles, which are the triangle
+  // vertex indices in the nodes (node dimensions mod 3)
+  vector <string> th;
+  th . push_back ("triangles");
+  XMLElement *tri = FindElement (geom, th);
+  if (! tri) {
+    printf ("unable to find the triangles XML element\n");
+    return SKETCHER_NO_TRIANGLES;
+  }
+
+  // the actual triangle points are here
+  vector <string> tvh;
+  tvh . push_back ("p");
+  XMLElement *tri_vert = FindElement (tri, tvh);
+  if (! tri_vert) {
+    printf ("unable to find the triangle vertex XML element\n");
+    return SKETCHER_NO_INDICES;
+  }
+
+  // the count attributes are only ever compared with what was read,
+  // but one past the limit saves tokenizing a file that is refused
+  int want = fa -> IntAttribute ("count");
+  int tri_want = tri -> IntAttribute ("count");
+  if (conv.max_triangles &&
+      (tri_want > conv.max_triangles || want / 9 > conv.max_triangles)) {
+    printf ("more than %d triangles\n", conv.max_triangles);
+    return SKETCHER_TOO_LARGE;
+  }
+
+  // nothing past here depends on anything but the two texts, so the
+  // same texts as the last conversion, which got through every check
+  // below, are spotted before either is tokenized
+  if (conv.state && fa -> GetText () && tri_vert -> GetText ()) {
+    mesh.geometry = hashText (hashText (FNV_OFFSET, fa -> GetText ()), tri_vert -> GetText ());
+    if (conv.state -> geometry == mesh.geometry) {
+      LOG (mesh.verbosity, LOG_NORMAL, "geometry unchanged\n");
+      mesh.unchanged = true;
+      return SKETCHER_OK;
+    }
+  }
+
+  // check the node dim count and parse the node dims
+  if (! fa -> GetText ()) {
+    printf ("the float_array XML element is empty\n");
+    return SKETCHER_NO_NODES;
+  }
+  // the texts and the weld are kept between conversions, but not by the
+  // on-disk path, which never holds a whole mesh in memory
+  convertState *again = conv.state && conv.state -> reuse && ! conv.mem_limit ? conv.state : NULL;
+  vector <double> node_dims;
+  size_t same_dims = 0, fresh_dims = 0;
+  {
+    traceSpan span (conv.trace, "tokenize", mesh.source);
+    if (again)
+      node_dims = splitAgain (conv.pool, fa -> GetText (), DoubleSplit,
+                              again -> node_text, again -> node_dims, same_dims, fresh_dims);
+    else
+      node_dims = splitText (conv.pool, fa -> GetText (), DoubleSplit);
+  }
+  int node_elems = (int)node_dims . size ();
+  if (node_elems != want)
+    LOG (mesh.verbosity, LOG_NORMAL, "node element want count %d not equal to got count %d\n", want, node_elems);
+  LOG (mesh.verbosity, LOG_VERBOSE, "found %d node elements\n", node_elems);
+  if (conv.max_triangles && node_elems / 9 > conv.max_triangles) {
+    printf ("more than %d triangles\n", conv.max_triangles);
+    return SKETCHER_TOO_LARGE;
+  }
+
+  // nan and infinity have no order, which welding and sorting rely on
+  for (int i = 0; i < node_elems; ++i)
+    if (! isfinite (node_dims [i])) {
+      printf ("node element %d is not a finite number\n", i);
+      return SKETCHER_NO_NODES;
+    }
+
+  want = tri_want;
+  if (! tri_vert -> GetText ()) {
+    printf ("the triangle vertex XML element is empty\n");
+    return SKETCHER_NO_INDICES;
+  }
+
+  // with a memory limit the triangles are never held at once. the
+  // beams are found from the index text through disk backed sorts
+  if (conv.mem_limit) {
+    if (! mesh . reserve (node_elems / 3, 0)) {
+      printf ("unable to allocate the mesh\n");
+      return SKETCHER_NO_MEMORY;
+    }
+    vector <unsigned int> remap;
+    {
+      traceSpan span (conv.trace, "weld", mesh.source);
+      extractNodes (mesh, node_dims);
+      vector <double> () . swap (node_dims);
+      weldPoints (mesh, remap);
+    }
+
+    traceSpan span (conv.trace, "extract", mesh.source);
+    int err = extractBeamsExternal (mesh, remap, tri_vert -> GetText (),
+                                    (size_t)conv.mem_limit << 20, conv.pipeline,
+                                    conv.max_triangles);
+    if (err == SKETCHER_SPILL)
+      printf ("unable to sort the beams on disk\n");
+    return err;
+  }
+
+  // check the triangle count and parse the triangle indices
+  vector <unsigned int> tridx;
+  size_t same_points = 0, fresh_points = 0;
+  {
+    traceSpan span (conv.trace, "tokenize", mesh.source);
+    if (again) {
+      tridx = splitAgain (conv.pool, tri_vert -> GetText (), UintSplit,
+                          again -> tri_text, again -> tri_points, same_points, fresh_points);
+      again -> tri_text = tri_vert -> GetText ();
+      again -> tri_points = tridx;
+      LOG (mesh.verbosity, LOG_VERBOSE, "tokenized %zu of %d node elements and %zu of %zu triangle indices\n",
+           fresh_dims, node_elems, fresh_points, tridx . size ());
+    } else {
+      tridx = splitText (conv.pool, tri_vert -> GetText (), UintSplit);
+    }
+  }
+  int tri_points = (int)tridx . size ();
+  if (tri_points / 3 != want)
+    LOG (mesh.verbosity, LOG_NORMAL, "triangle index want count %d not equal to got count %d\n", want, tri_points / 3);
+  LOG (mesh.verbosity, LOG_VERBOSE, "found %d triangle indices\n", tri_points);
+  if (conv.max_triangles && tri_points / 3 > conv.max_triangles) {
+    printf ("more than %d triangles\n", conv.max_triangles);
+    return SKETCHER_TOO_LARGE;
+  }
+
+  // one block for the whole conversion, sized by the counts above
+  if (! mesh . reserve (node_elems / 3, tri_points / 3)) {
+    printf ("unable to allocate the mesh\n");
+    return SKETCHER_NO_MEMORY;
+  }
+
+  {
+    traceSpan span (conv.trace, "weld", mesh.source);
+    extractNodes (mesh, node_dims);
+    extractTriangles (mesh, tridx);
+    if (again) {
+      // the points whose numbers all came over, and were welded before
+      int same = (int)min (same_dims / 3, again -> remap . size ());
+      weldFrom (mesh, again -> remap, again -> welded, min (same, mesh.node_count));
+      remapTriangles (mesh, again -> remap);
+      again -> node_text = fa -> GetText ();
+      again -> node_dims . swap (node_dims);
+    } else {
+      weldNodes (mesh);
+    }
+    cleanTriangles (mesh);
+    reportSurfaces (mesh);
+  }
+  if (conv.max_nodes) {
+    traceSpan span (conv.trace, "decimate", mesh.source);
+    decimateNodes (mesh, conv.max_nodes, conv.crease_degrees);
+  }
+  return SKETCHER_OK;
+}
+
+int Converter::parse (const char *fname, Mesh &mesh) const {
+  if (access (fname, R_OK)) {
+    printf ("unable to read: %s\n", fname);
+    return SKETCHER_UNREADABLE;
+  }
+
+  mesh.trace = trace;
+  mesh.source = fname;
+
+  XMLDocument doc;
+  LOG (verbosity, LOG_VERBOSE, "loading %s\n", fname);
+  XMLError ok;
+  {
+    traceSpan span (trace, "load", mesh.source);
+    ok = doc.LoadFile (fname);
+  }
+  if (ok != XML_SUCCESS) {
+    printf ("unable to parse the xml file: %s\n", fname);
+    return SKETCHER_BAD_XML;
+  }
+
+  return readCollada (*this, doc, mesh);
+}
+
+int Converter::parseBuffer (const char *xml, size_t len, Mesh &mesh) const {
+  mesh.trace = trace;
+  mesh.source = "buffer";
+
+  XMLDocument doc;
+  LOG (verbosity, LOG_VERBOSE, "loading %zu bytes\n", len);
+  XMLError ok;
+  {
+    traceSpan span (trace, "load", mesh.source);
+    ok = doc.Parse (xml, len);
+  }
+  if (ok != XML_SUCCESS) {
+    printf ("unable to parse the xml buffer\n");
+    return SKETCHER_BAD_XML;
+  }
+
+  return readCollada (*this, doc, mesh);
+}
+
+// v sits inside the segment a-b, within rounding
+static bool between (const vect &v, const vect &a, const vect &b) {
+  vect ab = b - a;
+  vect av = v - a;
+  double len_sq = ab . mag_sq ();
+  double along = ab.x * av.x + ab.y * av.y + ab.z * av.z;
+  if (along <= 0 || along >= len_sq) return false;
+  return ab . cross (av) . mag_sq () <= 1e-12 * len_sq * len_sq;
+}
+
+static void writeList (FILE *fp, const char *name, const vector <unsigned int> &v, int width) {
+  fprintf (fp, "    \"%s\": [", name);
+  for (size_t i = 0; i < v . size (); i += width) {
+    fprintf (fp, "%s", i ? ", " : "");
+    if (width > 1) fprintf (fp, "[");
+    for (int j = 0; j < width; ++j)
+      fprintf (fp, "%s%u", j ? ", " : "", v [i + j]);
+    if (width > 1) fprintf (fp, "]");
+  }
+  fprintf (fp, "],\n");
+}
+
+int Converter::validate (Mesh &mesh, const string &report) const {
+  sortEdges (mesh);
+
+  // one walk over the sorted edges: every run is one mesh edge and
+  // the triangles on it
+  vector <unsigned int> non_manifold;
+  vector <unsigned int> flipped;
+  vector <vector <unsigned int> > rim (mesh.node_count);
+  int boundary = 0;
+  int unique_edges = 0;
+  for (int i = 0; i < mesh.edge_count; ) {
+    const edge &e = mesh.edges [i];
+    int j = i + 1;
+    while (j < mesh.edge_count &&
+           mesh.edges [j] . lo () == e . lo () && mesh.edges [j] . hi () == e . hi ())
+      ++j;
+    int on = j - i;
+    unique_edges++;
+
+    if (on == 1) {
+      boundary++;
+      rim [e . lo ()] . push_back (e . hi ());
+      rim [e . hi ()] . push_back (e . lo ());
+    } else if (on == 2) {
+      // neighbours wound the same way run their shared edge opposite ways
+      if (mesh.edges [i + 1] . n1 == e.n1) {
+        flipped . push_back (e . lo ());
+        flipped . push_back (e . hi ());
+      }
+    } else {
+      non_manifold . push_back (e . lo ());
+      non_manifold . push_back (e . hi ());
+      non_manifold . push_back (on);
+    }
+    i = j;
+  }
+
+  // the boundary edges form loops, and a node sitting inside a
+  // boundary edge, between its ends, is a t junction
+  disjointSets loops (mesh.node_count);
+  vector <unsigned int> junctions;
+  for (int a = 0; a < mesh.node_count; ++a) {
+    for (size_t k = 0; k < rim [a] . size (); ++k) {
+      unsigned int b = rim [a][k];
+      loops . unite (a, b);
+      if (b < (unsigned int)a) continue;
+      for (size_t m = 0; m < rim [a] . size (); ++m) {
+        unsigned int v = rim [a][m];
+        if (v == b) continue;
+        if (find (rim [v] . begin (), rim [v] . end (), b) == rim [v] . end ()) continue;
+        if (! between (mesh.nodes [v], mesh.nodes [a], mesh.nodes [b])) continue;
+        junctions . push_back (v);
+        junctions . push_back (a);
+        junctions . push_back (b);
+      }
+    }
+  }
+  int boundary_loops = 0;
+  for (int a = 0; a < mesh.node_count; ++a)
+    if (! rim [a] . empty () && loops . find (a) == (unsigned int)a) boundary_loops++;
+
+  vector <unsigned int> label;
+  int surfaces = labelSurfaces (mesh, label);
+  vector <unsigned int> isolated;
+  for (int i = 0; i < mesh.node_count; ++i)
+    if (label [i] == NO_TRI) isolated . push_back (i);
+
+  bool valid = surfaces == 1 && non_manifold . empty () && flipped . empty () &&
+               junctions . empty () && isolated . empty ();
+
+  FILE *fp = fopen (report . c_str (), "w");
+  if (! fp) {
+    printf ("unable to write %s\n", report . c_str ());
+    return SKETCHER_EXPORT;
+  }
+  fprintf (fp, "{\n"
+               "    \"nodes\": %d,\n"
+               "    \"triangles\": %d,\n"
+               "    \"edges\": %d,\n"
+               "    \"surfaces\": %d,\n"
+               "    \"boundary_edges\": %d,\n"
+               "    \"boundary_loops\": %d,\n",
+               mesh.node_count, mesh.tri_count, unique_edges,
+               surfaces, boundary, boundary_loops);
+  writeList (fp, "non_manifold_edges", non_manifold, 3);
+  writeList (fp, "inconsistent_winding", flipped, 2);
+  writeList (fp, "t_junctions", junctions, 3);
+  writeList (fp, "isolated_nodes", isolated, 1);
+  fprintf (fp, "    \"valid\": %s\n"
+               "}\n",
+               valid ? "true" : "false");
+  fclose (fp);
+
+  LOG (verbosity, LOG_NORMAL, "%s: %d non-manifold edges, %d flipped neighbours, %d t junctions,"
+          " %d isolated nodes, %d boundary loops\n",
+           report . c_str (), (int)non_manifold . size () / 3, (int)flipped . size () / 2,
+           (int)junctions . size () / 3, (int)isolated . size (), boundary_loops);
+  return SKETCHER_OK;
+}
+
+// extract for one surface, or the whole mesh
+static void extractSurface (const Converter &conv, Mesh &mesh) {
+  traceSpan span (conv.trace, "extract", mesh.source);
+  if (conv.collision >= 0)
+    collisionTriangles (mesh, conv.collision, conv.crease_degrees);
+  else
+    mesh.collision_count = 0;
+  // one mesh a conversion, and pruning looks up the surface edges that
+  // a full pass sorts
+  bool again = conv.state && conv.split < 0 && conv.lods . empty () && conv.margin < 0;
+  extractBeams (mesh, again ? conv.state : NULL);
+  if (conv.margin >= 0)
+    pruneBeams (mesh, conv.margin);
+  if (! conv.order . empty ())
+    reorderNodes (mesh, conv.order);
+}
+
+// the surfaces of a split mesh, handed out to worker threads
+struct surfaceWork {
+  const Converter *conv;
+  Mesh *parts;
+  int count;
+  int next;
+  pthread_mutex_t lock;
+};
+
+struct surfaceTask {
+  const Converter *conv;
+  Mesh *part;
+};
+
+static void extractPart (void *arg) {
+  surfaceTask *t = (surfaceTask *)arg;
+  extractSurface (*t -> conv, *t -> part);
+}
+
+static void *extractSurfaces (void *arg) {
+  surfaceWork *w = (surfaceWork *)arg;
+  for (;;) {
+    pthread_mutex_lock (&w -> lock);
+    int k = w -> next++;
+    pthread_mutex_unlock (&w -> lock);
+    if (k >= w -> count) return NULL;
+    extractSurface (*w -> conv, w -> parts [k]);
+  }
+}
+
+// copy each surface into a mesh of its own, extract them side by side,
+// then put them back together one group after another. nodes on no
+// triangle are left out.
+static int splitSurfaces (const Converter &conv, Mesh &mesh) {
+  vector <unsigned int> label;
+  int count = labelSurfaces (mesh, label);
+  if (count < 2) {
+    extractSurface (conv, mesh);
+    return SKETCHER_OK;
+  }
+
+  vector <int> tris_in (count, 0);
+  vector <int> nodes_in (count, 0);
+  vector <unsigned int> local (mesh.node_count);
+  for (int i = 0; i < mesh.node_count; ++i)
+    if (label [i] != NO_TRI) local [i] = nodes_in [label [i]]++;
+  for (int f = 0; f < mesh.tri_count; ++f)
+    tris_in [label [mesh.tridx [f * 3]]]++;
+
+  Mesh *parts = new Mesh [count];
+  for (int k = 0; k < count; ++k) {
+    parts [k] . verbosity = mesh.verbosity;
+    parts [k] . trace = mesh.trace;
+    parts [k] . source = mesh.source;
+    if (! parts [k] . reserve (nodes_in [k], tris_in [k])) {
+      delete [] parts;
+      return SKETCHER_NO_MEMORY;
+    }
+  }
+  for (int i = 0; i < mesh.node_count; ++i) {
+    if (label [i] == NO_TRI) continue;
+    Mesh &part = parts [label [i]];
+    new (&part.nodes [part.node_count++]) vect (mesh.nodes [i]);
+  }
+  for (int f = 0; f < mesh.tri_count; ++f) {
+    const unsigned int *t = &mesh.tridx [f * 3];
+    Mesh &part = parts [label [t[0]]];
+    unsigned int *u = &part.tridx [part.tri_count++ * 3];
+    for (int j = 0; j < 3; ++j)
+      u[j] = local [t[j]];
+  }
+
+  // in a batch the surfaces go to the pool's threads, which take them
+  // between files
+  if (conv.pool) {
+    vector <surfaceTask> tasks (count);
+    taskGroup group;
+    for (int k = 0; k < count; ++k) {
+      tasks [k] . conv = &conv;
+      tasks [k] . part = &parts [k];
+      conv.pool -> spawn (group, extractPart, &tasks [k]);
+    }
+    conv.pool -> wait (group);
+    LOG (mesh.verbosity, LOG_VERBOSE, "extracted %d surfaces in the pool\n", count);
+  } else {
+    int threads = conv.split ? conv.split : (int)sysconf (_SC_NPROCESSORS_ONLN);
+    threads = max (1, min (threads, count));
+
+    surfaceWork work;
+    work.conv = &conv;
+    work.parts = parts;
+    work.count = count;
+    work.next = 0;
+    pthread_mutex_init (&work.lock, NULL);
+    vector <pthread_t> workers;
+    for (int i = 1; i < threads; ++i) {
+      pthread_t id;
+      if (! pthread_create (&id, NULL, extractSurfaces, &work))
+        workers . push_back (id);
+    }
+    extractSurfaces (&work);
+    for (int i = 0; i < (int)workers . size (); ++i)
+      pthread_join (workers [i], NULL);
+    pthread_mutex_destroy (&work.lock);
+
+    LOG (mesh.verbosity, LOG_VERBOSE, "extracted %d surfaces on %d threads\n", count, (int)workers . size () + 1);
+  }
+
+  int node_count = 0;
+  int tri_count = 0;
+  for (int k = 0; k < count; ++k) {
+    node_count += parts [k] . node_count;
+    tri_count += parts [k] . tri_count;
+  }
+  if (! mesh . reserve (node_count, tri_count)) {
+    delete [] parts;
+    return SKETCHER_NO_MEMORY;
+  }
+
+  for (int k = 0; k < count; ++k) {
+    const Mesh &part = parts [k];
+    unsigned int n0 = mesh.node_count;
+    unsigned int t0 = mesh.tri_count;
+    mesh.groups [mesh.group_count++] = n0;
+    for (int i = 0; i < part.node_count; ++i)
+      new (&mesh.nodes [mesh.node_count++]) vect (part.nodes [i]);
+    for (int i = 0; i < part.tri_count; ++i) {
+      new (&mesh.triangles [mesh.tri_count]) triangle (part.triangles [i]);
+      for (int j = 0; j < 3; ++j)
+        mesh.tridx [mesh.tri_count * 3 + j] = part.tridx [i * 3 + j] + n0;
+      mesh.tri_count++;
+    }
+    for (int i = 0; i < part.beam_count; ++i) {
+      const edge &b = part.beams [i];
+      unsigned int tri = b.tri == NO_TRI ? NO_TRI : b.tri + t0;
+      mesh.beams [mesh.beam_count++] = edge (b.n1 + n0, b.n2 + n0, tri);
+    }
+    for (int i = 0; i < part.collision_count * 3; ++i)
+      mesh.collision [mesh.collision_count * 3 + i] = part.collision [i] + n0;
+    mesh.collision_count += part.collision_count;
+  }
+
+  delete [] parts;
+  return SKETCHER_OK;
+}
+
+int Converter::extract (Mesh &mesh) const {
+  // already found on disk by parse
+  if (mesh.spill) return SKETCHER_OK;
+
+  if (split >= 0)
+    return splitSurfaces (*this, mesh);
+  extractSurface (*this, mesh);
+  return SKETCHER_OK;
+}
+
+int Converter::write (const Mesh &mesh, const string &dir,
+                      const string &author, const string &model) const {
+  vector <vect> mt_vect;
+  vector <beam> mt_beam;
+
+  if (exportJBeam (*this, dir, author, model, mesh, mt_vect, mt_beam, mt_beam)) {
+    LOG (verbosity, LOG_NORMAL, "successfully exported model %s\n", model . c_str());
+    return SKETCHER_OK;
+  }
+  printf ("error exporting %s\n", model . c_str());
+  return SKETCHER_EXPORT;
+}
+
+int Converter::writeJBeam (const Mesh &mesh, FILE *fp,
+                           const string &author, const string &model) const {
+  vector <vect> mt_vect;
+  vector <beam> mt_beam;
+
+  traceSpan span (trace, "serialize", mesh.source);
+  if (::writeJBeam (fp, *this, author, model, mesh, mt_vect, mt_beam, mt_beam))
+    return SKETCHER_OK;
+  printf ("error writing %s\n", model . c_str());
+  return SKETCHER_EXPORT;
+}
+
+// name each node after the one the last jbeam had at the same
+// position, and the rest past the highest id it used, so an edit
+// leaves the ids that other files refer to alone. ids that were
+// dropped are not handed out again. last becomes this jbeam's.
+static void keepIds (Mesh &mesh, nodeIds &last) {
+  unsigned int next = 0;
+  for (size_t i = 0; i < last . size (); ++i)
+    next = max (next, last [i] . second + 1);
+
+  int kept = 0;
+  nodeIds now (mesh.node_count);
+  mesh.ids . resize (mesh.node_count);
+  for (int i = 0; i < mesh.node_count; ++i) {
+    const vect &n = mesh.nodes [i];
+    nodeIds::const_iterator at = lower_bound (last . begin (), last . end (), make_pair (n, 0u));
+    if (at != last . end () && at -> first == n) {
+      mesh.ids [i] = at -> second;
+      kept++;
+    } else
+      mesh.ids [i] = next++;
+    now [i] = make_pair (n, mesh.ids [i]);
+  }
+  sort (now . begin (), now . end ());
+
+  if (! last . empty ())
+    LOG (mesh.verbosity, LOG_NORMAL, "kept %d of %d node ids, %d new\n",
+             kept, (int)last . size (), mesh.node_count - kept);
+  last . swap (now);
+}
+
+// the state file: a tag, the number of jbeams, then for each the
+// number of nodes and their x, y, z as doubles and id. after those the
+// number of triangles and their corners as nine doubles, then the
+// number of co-planar pairs and the two triangles of each. all in the
+// byte order of the machine that wrote it. a file of the first kind
+// has no triangles or pairs.
+static const char STATE_TAG[8] = { 's', 'k', 'e', 't', 'i', 'd', 's', '2' };
+static const char STATE_TAG_IDS[8] = { 's', 'k', 'e', 't', 'i', 'd', 's', '1' };
+
+static bool readPoint (FILE *fp, vect &v) {
+  double p[3];
+  if (fread (p, sizeof (double), 3, fp) != 3) return false;
+  v = vect (p[0], p[1], p[2]);
+  return true;
+}
+
+static void writePoint (FILE *fp, const vect &v) {
+  double p[3] = { v.x, v.y, v.z };
+  fwrite (p, sizeof (double), 3, fp);
+}
+
+bool convertState::load (const char *path) {
+  FILE *fp = fopen (path, "rb");
+  if (! fp) return false;
+
+  char tag[8];
+  unsigned int count = 0;
+  bool ok = fread (tag, 1, 8, fp) == 8 &&
+            (! memcmp (tag, STATE_TAG, 8) || ! memcmp (tag, STATE_TAG_IDS, 8)) &&
+            fread (&count, sizeof (count), 1, fp) == 1;
+  bool beams = ok && ! memcmp (tag, STATE_TAG, 8);
+  vector <nodeIds> got;
+  for (unsigned int k = 0; ok && k < count; ++k) {
+    unsigned int nodes = 0;
+    ok = fread (&nodes, sizeof (nodes), 1, fp) == 1;
+    got . push_back (nodeIds ());
+    for (unsigned int i = 0; ok && i < nodes; ++i) {
+      vect n;
+      unsigned int id;
+      ok = readPoint (fp, n) && fread (&id, sizeof (id), 1, fp) == 1;
+      got . back () . push_back (make_pair (n, id));
+    }
+    // rounded into floats by a FLOAT32 build, so sort again
+    sort (got . back () . begin (), got . back () . end ());
+  }
+
+  vector <triangle> tris;
+  vector <pair <unsigned int, unsigned int> > pairs;
+  if (ok && beams) {
+    unsigned int tri_count = 0, pair_count = 0;
+    ok = fread (&tri_count, sizeof (tri_count), 1, fp) == 1;
+    for (unsigned int i = 0; ok && i < tri_count; ++i) {
+      triangle t;
+      ok = readPoint (fp, t.p1) && readPoint (fp, t.p2) && readPoint (fp, t.p3);
+      tris . push_back (t);
+    }
+    ok = ok && fread (&pair_count, sizeof (pair_count), 1, fp) == 1;
+    for (unsigned int i = 0; ok && i < pair_count; ++i) {
+      unsigned int p[2];
+      ok = fread (p, sizeof (unsigned int), 2, fp) == 2;
+      pairs . push_back (make_pair (p[0], p[1]));
+    }
+  }
+  fclose (fp);
+
+  if (ok) {
+    ids . swap (got);
+    triangles . swap (tris);
+    near . swap (pairs);
+  }
+  return ok;
+}
+
+bool convertState::save (const char *path) const {
+  FILE *fp = fopen (path, "wb");
+  if (! fp) return false;
+
+  unsigned int count = (unsigned int)ids . size ();
+  fwrite (STATE_TAG, 1, 8, fp);
+  fwrite (&count, sizeof (count), 1, fp);
+  for (unsigned int k = 0; k < count; ++k) {
+    unsigned int nodes = (unsigned int)ids [k] . size ();
+    fwrite (&nodes, sizeof (nodes), 1, fp);
+    for (unsigned int i = 0; i < nodes; ++i) {
+      writePoint (fp, ids [k] [i] . first);
+      fwrite (&ids [k] [i] . second, sizeof (unsigned int), 1, fp);
+    }
+  }
+
+  unsigned int tri_count = (unsigned int)triangles . size ();
+  fwrite (&tri_count, sizeof (tri_count), 1, fp);
+  for (unsigned int i = 0; i < tri_count; ++i) {
+    writePoint (fp, triangles [i] . p1);
+    writePoint (fp, triangles [i] . p2);
+    writePoint (fp, triangles [i] . p3);
+  }
+  unsigned int pair_count = (unsigned int)near . size ();
+  fwrite (&pair_count, sizeof (pair_count), 1, fp);
+  for (unsigned int i = 0; i < pair_count; ++i) {
+    unsigned int p[2] = { near [i] . first, near [i] . second };
+    fwrite (p, sizeof (unsigned int), 2, fp);
+  }
+  bool ok = ! ferror (fp);
+  return fclose (fp) == 0 && ok;
+}
+
+int Converter::convert (const char *fname, const string &dir,
+                        const string &author, const string &model) const {
+  Mesh mesh;
+  int err = parse (fname, mesh);
+  if (err) return err;
+  if (mesh.unchanged) return SKETCHER_OK;
+  unsigned long long geometry = mesh.geometry;
+
+  if (state)
+    state -> ids . resize (max ((size_t)1, lods . size ()));
+
+  if (lods . empty ()) {
+    err = extract (mesh);
+    if (! err && state)
+      keepIds (mesh, state -> ids [0]);
+    if (! err)
+      err = write (mesh, dir, author, model);
+    if (! err && state)
+      state -> geometry = geometry;
+    return err;
+  }
+
+  // each level is reduced from the one above it, so the quadrics and
+  // collapse queue are only built once for the whole set
+  int status = SKETCHER_OK;
+  vector <unsigned int> levels = lods;
+  sort (levels . begin (), levels . end (), greater <unsigned int> ());
+  decimator d (mesh, false, crease_degrees);
+  for (int i = 0; i < (int)levels . size (); ++i) {
+    d . reduce (levels [i]);
+    d . snapshot (mesh);
+    LOG (verbosity, LOG_NORMAL, "level of detail %u: %d nodes, %d triangles\n",
+             levels [i], mesh.node_count, mesh.tri_count);
+
+    char sub[32];
+    snprintf (sub, sizeof (sub), "lod%u", levels [i]);
+    string at = dir . empty () ? string (sub) : dir + "/" + sub;
+    mkdir (at . c_str (), 0755);
+    err = extract (mesh);
+    if (! err && state)
+      keepIds (mesh, state -> ids [i]);
+    if (! err)
+      err = write (mesh, at, author, model);
+    if (err) status = err;
+  }
+
+  if (! status && state)
+    state -> geometry = geometry;
+  return status;
+}
+
+// a flat grid of cols by rows squares, two triangles each, written
+// the way sketchup does with every triangle on its own three vertices
+static string gridCollada (int cols, int rows) {
+  int tris = cols * rows * 2;
+  string xml;
+  xml . reserve ((size_t)tris * 64 + 512);
+  char buf[256];    // twelve of the widest ints and their separators
+
+  snprintf (buf, sizeof (buf),
+            "<COLLADA><library_geometries><geometry><mesh><source>"
+            "<float_array count=\"%d\">", tris * 9);
+  xml += buf;
+  for (int r = 0; r < rows; ++r)
+    for (int c = 0; c < cols; ++c) {
+      snprintf (buf, sizeof (buf), "%d %d 0 %d %d 0 %d %d 0 %d %d 0 %d %d 0 %d %d 0 ",
+                c, r, c + 1, r, c + 1, r + 1,
+                c, r, c + 1, r + 1, c, r + 1);
+      xml += buf;
+    }
+
+  snprintf (buf, sizeof (buf), "</float_array></source><triangles count=\"%d\"><p>", tris);
+  xml += buf;
+  for (int i = 0; i < tris * 3; ++i) {
+    snprintf (buf, sizeof (buf), "%d ", i);
+    xml += buf;
+  }
+  xml += "</p></triangles></mesh></geometry></library_geometries></COLLADA>";
+  return xml;
+}
+
+// least squares slope of log y against log x
+static double growth (const vector <double> &x, const vector <double> &y) {
+  double sx = 0, sy = 0, sxx = 0, sxy = 0;
+  int n = (int)x . size ();
+  for (int i = 0; i < n; ++i) {
+    double lx = log (x [i]);
+    double ly = log (max (y [i], 1e-9));
+    sx += lx;
+    sy += ly;
+    sxx += lx * lx;
+    sxy += lx * ly;
+  }
+  return (n * sxy - sx * sy) / (n * sxx - sx * sx);
+}
+
+int Converter::scaling (double exponent) const {
+  Converter quiet = *this;
+  quiet.verbosity = LOG_QUIET;
+
+  FILE *sink = fopen ("/dev/null", "w");
+  if (! sink) {
+    printf ("unable to open /dev/null\n");
+    return SKETCHER_EXPORT;
+  }
+
+  // best of three for the time, which is what the code costs rather
+  // than what else the machine was doing
+  vector <double> tris, ms, heap;
+  bool counted = memoryStats::enabled ();
+  LOG (verbosity, LOG_NORMAL, "%10s %10s%s\n", "triangles", "ms",
+       counted ? "     peak bytes" : "");
+  for (int rows = 50; rows <= 800; rows *= 2) {
+    string xml = gridCollada (100, rows);
+    double best = 0;
+    size_t peak = 0;
+    for (int run = 0; run < 3; ++run) {
+      size_t outer_peak = memoryStats::markPeak ();
+      memoryStats before = memoryStats::now ();
+      double start = tracer::now ();
+
+      Mesh mesh;
+      int err = quiet . parseBuffer (xml . c_str (), xml . size (), mesh);
+      if (! err)
+        err = quiet . extract (mesh);
+      if (! err)
+        err = quiet . writeJBeam (mesh, sink, "scaling", "grid");
+
+      double took = (tracer::now () - start) / 1e3;
+      memoryStats after = memoryStats::now ();
+      memoryStats::restorePeak (outer_peak);
+      if (err) {
+        fclose (sink);
+        return err;
+      }
+      if (! run || took < best) best = took;
+      peak = after.peak - before.live;
+    }
+
+    tris . push_back (100.0 * rows * 2);
+    ms . push_back (best);
+    heap . push_back ((double)peak);
+    if (counted)
+      LOG (verbosity, LOG_NORMAL, "%10.0f %10.1f %14zu\n", tris . back (), best, peak);
+    else
+      LOG (verbosity, LOG_NORMAL, "%10.0f %10.1f\n", tris . back (), best);
+  }
+  fclose (sink);
+
+  int status = SKETCHER_OK;
+  double time_growth = growth (tris, ms);
+  LOG (verbosity, LOG_NORMAL, "time grows as n^%.2f\n", time_growth);
+  if (time_growth > exponent) {
+    printf ("time grows as n^%.2f, faster than n^%.2f\n", time_growth, exponent);
+    status = SKETCHER_SCALING;
+  }
+  if (counted) {
+    double heap_growth = growth (tris, heap);
+    LOG (verbosity, LOG_NORMAL, "heap grows as n^%.2f\n", heap_growth);
+    if (heap_growth > exponent) {
+      printf ("heap grows as n^%.2f, faster than n^%.2f\n", heap_growth, exponent);
+      status = SKETCHER_SCALING;
+    }
+  }
+  return status;
+}
+
+struct batchWork {
+  const Converter *conv;
+  const vector <string> *files;
+  const string *dir;
+  const string *author;
+  int verbosity;
+  int failed;
+  int status;
+  pthread_mutex_t lock;
+};
+
+struct batchFile {
+  batchWork *work;
+  size_t index;
+  size_t bytes;
+};
+
+struct biggerFile {
+  bool operator() (const batchFile &a, const batchFile &b) const { return a.bytes > b.bytes; }
+};
+
+// a file name without its directory or extension
+static string modelName (const string &path) {
+  size_t slash = path . find_last_of ('/');
+  string name = slash == string::npos ? path : path . substr (slash + 1);
+  size_t dot = name . find_last_of ('.');
+  return dot == string::npos || ! dot ? name : name . substr (0, dot);
+}
+
+static void convertFile (void *arg) {
+  batchFile *f = (batchFile *)arg;
+  batchWork *w = f -> work;
+  const string &fname = (*w -> files) [f -> index];
+  string model = modelName (fname);
+  string at = w -> dir -> empty () ? model : *w -> dir + "/" + model;
+  mkdir (at . c_str (), 0755);
+
+  double start = tracer::now ();
+  int err = w -> conv -> convert (fname . c_str (), at, *w -> author, model);
+  double took = (tracer::now () - start) / 1e3;
+
+  pthread_mutex_lock (&w -> lock);
+  if (err) {
+    printf ("%s: failed with %d\n", fname . c_str (), err);
+    rmdir (at . c_str ());    // only if nothing was written
+    w -> failed++;
+    if (! w -> status) w -> status = err;
+  } else {
+    LOG (w -> verbosity, LOG_NORMAL, "%s: %.1f ms\n", fname . c_str (), took);
+  }
+  pthread_mutex_unlock (&w -> lock);
+}
+
+int Converter::batch (const vector <string> &files, const string &dir,
+                      const string &author, int jobs) const {
+  // each model is written to a directory named after its file, so two
+  // files of the same name from different directories would overwrite
+  // each other's output. refuse the list before converting anything.
+  vector <pair <string, size_t> > names (files . size ());
+  for (size_t i = 0; i < files . size (); ++i)
+    names [i] = make_pair (modelName (files [i]), i);
+  sort (names . begin (), names . end ());
+  int clashes = 0;
+  for (size_t i = 1; i < names . size (); ++i)
+    if (names [i] . first == names [i-1] . first) {
+      printf ("%s and %s would both be written to %s\n",
+              files [names [i-1] . second] . c_str (), files [names [i] . second] . c_str (),
+              names [i] . first . c_str ());
+      clashes++;
+    }
+  if (clashes) return SKETCHER_USAGE;
+
+  int threads = jobs ? jobs : (int)sysconf (_SC_NPROCESSORS_ONLN);
+  threads = max (1, threads);
+
+  // this thread waits in the pool too, so it makes up the count. the
+  // files are queued biggest first, and their pieces are queued by
+  // the thread converting them for any thread without a file to take.
+  taskPool pool (threads - 1);
+
+  // a line per file from here, and the stages only when asked for more
+  Converter quiet = *this;
+  quiet.verbosity = max ((int)LOG_QUIET, verbosity - 1);
+  quiet.pool = &pool;
+
+  batchWork work;
+  work.conv = &quiet;
+  work.files = &files;
+  work.dir = &dir;
+  work.author = &author;
+  work.verbosity = verbosity;
+  work.failed = 0;
+  work.status = SKETCHER_OK;
+  pthread_mutex_init (&work.lock, NULL);
+
+  vector <batchFile> queue (files . size ());
+  size_t total = 0;
+  for (size_t i = 0; i < files . size (); ++i) {
+    struct stat st;
+    queue [i] . work = &work;
+    queue [i] . index = i;
+    queue [i] . bytes = stat (files [i] . c_str (), &st) ? 0 : st.st_size;
+    total += queue [i] . bytes;
+  }
+  stable_sort (queue . begin (), queue . end (), biggerFile ());
+
+  double start = tracer::now ();
+  taskGroup group;
+  for (size_t i = 0; i < queue . size (); ++i)
+    pool . spawn (group, convertFile, &queue [i]);
+  pool . wait (group);
+  double secs = (tracer::now () - start) / 1e6;
+  pthread_mutex_destroy (&work.lock);
+
+  int done = (int)files . size () - work.failed;
+  double mb = total / 1048576.0;
+  LOG (verbosity, LOG_NORMAL, "converted %d of %zu files, %.1f MB in %.2f s on %d threads:"
+       " %.1f files/s, %.1f MB/s\n",
+       done, files . size (), mb, secs, (int)pool.threads . size () + 1,
+       secs > 0 ? done / secs : 0, secs > 0 ? mb / secs : 0);
+  return work.status;
+}
+
+// Any two triangles that have the same normal and share a line,
+// should have a beam between the vertex opposite the shared line.
@@ -0,0 +1,135 @@
+/*
+ * (c) 2017 the mullican group
+ * kevin mullican
+ *
+ * memstats.cpp
+ *
+ * heap accounting. built with SKETCHER_MEMSTATS, the global operator new
+ * and delete keep a size header on every block and count calls, bytes,
+ * and the live and peak totals. that covers the containers, the mesh
+ * arena and tinyxml2's MemPoolT blocks, which all come through new.
+ * c library buffers, like those behind tmpfile, are not seen.
+ */
+
+#include <new>
+
+#include <stdlib.h>
+
+#include <sys/resource.h>
+
+#include "sketcher.h"
+
+#ifdef SKETCHER_MEMSTATS
+
+static unsigned long heap_allocations;
+static size_t heap_allocated;
+static size_t heap_live;
+static size_t heap_peak;
+
+// keeps max_align_t alignment for the block behind it
+#define HEADER 16
+
+static void *counted (size_t size) {
+  char *p = (char *)malloc (size + HEADER);
+  if (! p) return NULL;
+  *(size_t *)p = size;
+
+  __atomic_add_fetch (&heap_allocations, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch (&heap_allocated, size, __ATOMIC_RELAXED);
+  size_t now = __atomic_add_fetch (&heap_live, size, __ATOMIC_RELAXED);
+  size_t was = __atomic_load_n (&heap_peak, __ATOMIC_RELAXED);
+  while (now > was &&
+         ! __atomic_compare_exchange_n (&heap_peak, &was, now, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+  return p + HEADER;
+}
+
+static void uncounted (void *ptr) {
+  if (! ptr) return;
+  char *p = (char *)ptr - HEADER;
+  __atomic_sub_fetch (&heap_live, *(size_t *)p, __ATOMIC_RELAXED);
+  free (p);
+}
+
+void *operator new (size_t size) {
+  void *p = counted (size);
+  if (! p) throw std::bad_alloc ();
+  return p;
+}
+
+void *operator new [] (size_t size) {
+  void *p = counted (size);
+  if (! p) throw std::bad_alloc ();
+  return p;
+}
+
+void *operator new (size_t size, const std::nothrow_t &) noexcept {
+  return counted (size);
+}
+
+void *operator new [] (size_t size, const std::nothrow_t &) noexcept {
+  return counted (size);
+}
+
+void operator delete (void *p) noexcept { uncounted (p); }
+void operator delete [] (void *p) noexcept { uncounted (p); }
+void operator delete (void *p, size_t) noexcept { uncounted (p); }
+void operator delete [] (void *p, size_t) noexcept { uncounted (p); }
+void operator delete (void *p, const std::nothrow_t &) noexcept { uncounted (p); }
+void operator delete [] (void *p, const std::nothrow_t &) noexcept { uncounted (p); }
+
+bool memoryStats::enabled () {
+  return true;
+}
+
+memoryStats memoryStats::now () {
+  memoryStats m;
+  m.allocations = __atomic_load_n (&heap_allocations, __ATOMIC_RELAXED);
+  m.bytes = __atomic_load_n (&heap_allocated, __ATOMIC_RELAXED);
+  m.live = __atomic_load_n (&heap_live, __ATOMIC_RELAXED);
+  m.peak = __atomic_load_n (&heap_peak, __ATOMIC_RELAXED);
+
+  struct rusage ru;
+  getrusage (RUSAGE_SELF, &ru);
+  m.max_rss_kb = ru.ru_maxrss;
+  return m;
+}
+
+size_t memoryStats::markPeak () {
+  size_t now = __atomic_load_n (&heap_live, __ATOMIC_RELAXED);
+  return __atomic_exchange_n (&heap_peak, now, __ATOMIC_RELAXED);
+}
+
+void memoryStats::restorePeak (size_t old) {
+  size_t was = __atomic_load_n (&heap_peak, __ATOMIC_RELAXED);
+  while (old > was &&
+         ! __atomic_compare_exchange_n (&heap_peak, &was, old, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+#else
+
+bool memoryStats::enabled () {
+  return false;
+}
+
+memoryStats memoryStats::now () {
+  memoryStats m;
+  m.allocations = 0;
+  m.bytes = 0;
+  m.live = 0;
+  m.peak = 0;
+  m.max_rss_kb = 0;
+  return m;
+}
+
+size_t memoryStats::markPeak () {
+  return 0;
+}
+
+void memoryStats::restorePeak (size_t) {
+}
+
+#endif
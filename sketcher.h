@@ -0,0 +1,616 @@
+/*
+ * (c) 2017 the mullican group
+ * kevin mullican
+ *
+ * sketcher.h
+ *
+ * library interface: the mesh a conversion works on, and the converter
+ * that turns a collada file exported from sketchup into a beamng.drive
+ * jbeam
+ */
+
+#ifndef SKETCHER_H
+#define SKETCHER_H
+
+#include <vector>
+#include <map>
+#include <string>
+#include <utility>
+#include <new>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "sketcher_c.h"
+
+// a point or direction. positions are stored as real, which is
+// double unless built with SKETCHER_FLOAT32, while lengths and
+// products are always worked out in double.
+template <typename T> struct vec3 {
+  T x;
+  T y;
+  T z;
+  vec3() { x = 0; y = 0; z = 0; }
+  vec3(double _x, double _y, double _z) {
+    x = _x; y = _y; z = _z;
+  }
+  vec3 (const vec3 &v) {
+    x = v.x; y = v.y; z = v.z;
+  }
+  vec3 &set (double _x, double _y, double _z) {
+    x = _x; y = _y; z = _z;
+    return *this;
+  }
+  // x = vy * z - vz * y
+  // y = vz * x - vx * z
+  // z = vx * y - vy * x
+  vec3 cross(const vec3 &v) const {
+    vec3 c;
+    c.x = (v.y * z) - (v.z * y);
+    c.y = (v.z * x) - (v.x * z);
+    c.z = (v.x * y) - (v.y * x);
+    return c;
+  }
+  double mag_sq() const {
+    return (double)x*x + (double)y*y + (double)z*z;
+  }
+  double mag() const {
+    return sqrt(mag_sq());
+  }
+  vec3 norm() const {
+    double l = mag();
+    if (l == 0.0) return vec3();
+    return vec3 (x/l, y/l, z/l);
+  }
+  vec3 neg() const {
+    return vec3(-x, -y, -z);
+  }
+  vec3 &neg() {
+    x = -x; y = -y; z = -z;
+    return *this;
+  }
+  vec3& operator+ (const vec3 &v) {
+    x += v.x; y += v.y; z += v.z;
+    return *this;
+  }
+  vec3& operator- (const vec3 &v) {
+    x -= v.x; y -= v.y; z -= v.z;
+    return *this;
+  }
+  vec3 operator+ (const vec3 &v) const {
+    return vec3 (x + v.x, y + v.y, z + v.z);
+  }
+  vec3 operator- (const vec3 &v) const {
+    return vec3 (x - v.x, y - v.y, z - v.z);
+  }
+  vec3& operator= (const vec3 &v) {
+    x = v.x; y = v.y; z = v.z;
+    return *this;
+  }
+  bool operator== (const vec3 &v) const {
+    if (x == v.x && y == v.y && z == v.z)
+      return true;
+    return false;
+  }
+  // lexicographic, so points can key a map
+  bool operator< (const vec3 &v) const {
+    if (x != v.x) return x < v.x;
+    if (y != v.y) return y < v.y;
+    return z < v.z;
+  }
+  void print(bool newline = false) const {
+    printf ("%0.2f, %0.2f, %0.2f", (double)x, (double)y, (double)z);
+    if (newline) printf("\n");
+  }
+};
+
+#ifdef SKETCHER_FLOAT32
+typedef float real;
+#else
+typedef double real;
+#endif
+typedef vec3 <real> vect;
+
+struct beam {
+  vect p1;
+  vect p2;
+  beam() {}
+  beam(vect _p1, vect _p2) {
+    p1 = _p1; p2 = _p2;
+  }
+  beam(const beam &b) {
+    p1 = b.p1; p2 = b.p2;
+  }
+  beam &set(const vect &_p1, const vect &_p2) {
+    p1 = _p1;
+    p2 = _p2;
+    return *this;
+  }
+  beam &operator= (const beam &b) {
+    p1 = b.p1;
+    p2 = b.p2;
+    return *this;
+  }
+  bool operator== (const beam &b) const {
+    if (p1 == b.p1 && p2 == b.p2) return true;
+    if (p1 == b.p2 && p2 == b.p1) return true;
+    return false;
+  }
+  void print(bool newline = false) const {
+    printf ("p1: [");
+    p1.print();
+    printf("] p2: [");
+    p2.print();
+    printf ("]");
+    if (newline) printf ("\n");
+  }
+};
+
+struct triangle {
+  vect p1;
+  vect p2;
+  vect p3;
+  triangle() {}
+  triangle(vect _p1, vect _p2, vect _p3) {
+    p1 = _p1;
+    p2 = _p2;
+    p3 = _p3;
+  }
+  triangle(const triangle &t) {
+    p1 = t.p1;
+    p2 = t.p2;
+    p3 = t.p3;
+  }
+  triangle &set (vect _p1, vect _p2, vect _p3) {
+    p1 = _p1;
+    p2 = _p2;
+    p3 = _p3;
+    return *this;
+  }
+  int sharedPoints(const triangle &t) const {
+    int same = 0;
+    if (p1 == t.p1 || p1 == t.p2 || p1 == t.p3)
+      same++;
+    if (p2 == t.p1 || p2 == t.p2 || p2 == t.p3)
+      same++;
+    if (p3 == t.p1 || p3 == t.p2 || p3 == t.p3)
+      same++;
+    return same;
+  }
+  vect normal() const {
+    vect pp2 = p2 - p1;
+    vect pp3 = p3 - p1;
+    vect cr = pp2 . cross (pp3);
+    return cr.norm();
+  }
+  bool touching(const triangle &t) const {
+    if (sharedPoints(t) == 1) return true;
+    return false;
+  }
+  bool adjacent(const triangle &t) const {
+    if (sharedPoints(t) == 2) return true;
+    return false;
+  }
+  bool same(const triangle &t) const {
+    if (sharedPoints(t) == 3) return true;
+    return false;
+  }
+  bool sameOrientation(const triangle &t) const {
+    vect tn = t.normal();
+    vect n = normal();
+    if (tn == n) return true;
+    if (tn == n.neg()) return true;
+    return false;
+  }
+  bool contains (const vect &pt) const {
+    if (pt == p1 || pt == p2 || pt == p3)
+      return true;
+    return false;
+  }
+  bool contains (const beam &b) const {
+    beam b12 (p1, p2);
+    if (b12 == b) return true;
+    beam b13 (p1, p3);
+    if (b13 == b) return true;
+    beam b23 (p2, p3);
+    if (b23 == b) return true;
+    return false;
+  }
+  bool isLongest (const beam &b) const {
+    if (! contains (b)) return false;
+    vect vb = b.p1 - b.p2;
+    double mb = vb . mag_sq ();
+    vect v12 = p1 - p2;
+    double m12 = v12 . mag_sq ();
+    vect v13 = p1 - p3;
+    double m13 = v13 . mag_sq ();
+    vect v23 = p2 - p3;
+    double m23 = v23 . mag_sq ();
+    if (mb >= m12 && mb >= m13 && mb >= m23)
+      return true;
+    return false;
+  }
+  triangle& operator= (const triangle &t) {
+    p1 = t.p1; p2 = t.p2; p3 = t.p3;
+    return *this;
+  }
+  bool operator== (const triangle &t) const {
+    if (sharedPoints(t) == 3)
+      return true;
+    return false;
+  }
+  void print (bool newline = false) const {
+    printf("p1: [");
+    p1.print();
+    printf("] p2: [");
+    p2.print();
+    printf("] p3: [");
+    p3.print();
+    printf("]");
+    if (newline) printf ("\n");
+  }
+};
+
+// no triangle, for beams that are not a triangle edge, and a
+// marker for beams about to be dropped
+#define NO_TRI 0xffffffffu
+#define DUP_TRI 0xfffffffeu
+
+// a beam or triangle edge between two nodes, by node index, and
+// the triangle it is an edge of
+struct edge {
+  unsigned int n1;
+  unsigned int n2;
+  unsigned int tri;
+  edge() { n1 = 0; n2 = 0; tri = NO_TRI; }
+  edge(unsigned int _n1, unsigned int _n2, unsigned int _tri = NO_TRI) {
+    n1 = _n1; n2 = _n2; tri = _tri;
+  }
+  unsigned int lo() const { return n1 < n2 ? n1 : n2; }
+  unsigned int hi() const { return n1 < n2 ? n2 : n1; }
+  // by end points regardless of direction, then by triangle
+  bool operator< (const edge &e) const {
+    if (lo() != e.lo()) return lo() < e.lo();
+    if (hi() != e.hi()) return hi() < e.hi();
+    return tri < e.tri;
+  }
+};
+
+// bump allocator: one block up front, handed out front to back
+// and freed all at once. the block comes from operator new so the
+// allocation counts see it.
+struct arena {
+  char *base;
+  size_t size;
+  size_t used;
+  arena() { base = NULL; size = 0; used = 0; }
+  ~arena() { delete [] base; }
+  bool reserve(size_t bytes) {
+    delete [] base;
+    base = new (std::nothrow) char [bytes];
+    size = base ? bytes : 0;
+    used = 0;
+    return base != NULL;
+  }
+  template <typename T> T *take(size_t count) {
+    size_t at = (used + 15) & ~(size_t)15;
+    if (at + count * sizeof (T) > size) return NULL;
+    used = at + count * sizeof (T);
+    return (T *)(base + at);
+  }
+private:
+  arena(const arena &);
+  arena &operator= (const arena &);
+};
+
+// heap use through operator new, which is only counted when built
+// with SKETCHER_MEMSTATS; otherwise everything reads zero
+struct memoryStats {
+  unsigned long allocations;  // calls so far
+  size_t bytes;               // bytes asked for so far
+  size_t live;                // bytes held now
+  size_t peak;                // most bytes held at once, since the last mark
+  long max_rss_kb;            // the process's peak resident set so far
+
+  static bool enabled();
+  static memoryStats now();
+  // start a new peak from what is held now, returning the old one
+  static size_t markPeak();
+  // fold an old peak back in once a nested mark is done with
+  static void restorePeak(size_t old);
+};
+
+// hardware counters for the calling thread, through perf_event_open.
+// only user space is counted, so the default perf_event_paranoid of 2
+// is enough; open fails where the kernel or the machine has none.
+struct perfCounters {
+  enum {
+    CYCLES,
+    INSTRUCTIONS,
+    CACHE_REFERENCES,
+    CACHE_MISSES,
+    BRANCHES,
+    BRANCH_MISSES,
+    COUNT
+  };
+  int fd[COUNT];
+
+  perfCounters() { for (int i = 0; i < COUNT; ++i) fd[i] = -1; }
+  ~perfCounters() { close (); }
+  bool open();
+  // the counts since open, scaled up if the counters were shared
+  bool read(unsigned long long *counts);
+  void close();
+private:
+  perfCounters(const perfCounters &);
+  perfCounters &operator= (const perfCounters &);
+};
+
+// collects timed spans from any number of threads and conversions,
+// and writes them in the chrome trace event format for perfetto or
+// chrome://tracing
+struct tracer {
+  struct span {
+    const char *name;
+    std::string file;
+    double start;     // microseconds
+    double length;
+    long thread;
+    unsigned long allocations;  // heap use inside the span, if counted
+    size_t bytes;
+    size_t peak;
+    long max_rss_kb;
+    bool counted;               // hardware counters, with --perf-counters
+    unsigned long long counts[perfCounters::COUNT];
+  };
+  std::vector <span> spans;
+  pthread_mutex_t lock;
+  bool counters;                // read the hardware counters in each span
+
+  tracer() : counters (false) { pthread_mutex_init (&lock, NULL); }
+  ~tracer() { pthread_mutex_destroy (&lock); }
+  static double now();
+  void add(const span &s);
+  bool write(const char *path);
+  // total the heap use of each stage, for builds that count it
+  void printMemory(FILE *fp);
+  // total the counters of each stage, with instructions per cycle and
+  // the cache and branch miss rates
+  void printCounters(FILE *fp);
+private:
+  tracer(const tracer &);
+  tracer &operator= (const tracer &);
+};
+
+// times the rest of the enclosing scope into a tracer, if there is
+// one, with the heap use over that time. the peak is only exact while
+// one thread is allocating.
+struct traceSpan {
+  tracer *trace;
+  const char *name;
+  const std::string &file;
+  double start;
+  memoryStats before;
+  size_t outer_peak;
+  perfCounters counters;
+  traceSpan(tracer *_trace, const char *_name, const std::string &_file)
+    : trace (_trace), name (_name), file (_file) {
+    if (! trace) return;
+    outer_peak = memoryStats::markPeak ();
+    before = memoryStats::now ();
+    if (trace -> counters) counters . open ();
+    start = tracer::now ();
+  }
+  ~traceSpan() {
+    if (! trace) return;
+    tracer::span s;
+    s.name = name;
+    s.file = file;
+    s.start = start;
+    s.length = tracer::now () - start;
+    s.counted = counters . read (s.counts);
+    memoryStats after = memoryStats::now ();
+    s.allocations = after.allocations - before.allocations;
+    s.bytes = after.bytes - before.bytes;
+    s.peak = after.peak - before.live;
+    s.max_rss_kb = after.max_rss_kb;
+    memoryStats::restorePeak (outer_peak);
+    trace -> add (s);
+  }
+};
+
+// how much a conversion prints: errors only, a line per stage, the
+// parse details too, or every cross beam as well
+enum {
+  LOG_QUIET = 0,
+  LOG_NORMAL = 1,
+  LOG_VERBOSE = 2,
+  LOG_TRACE = 3
+};
+
+// everything one conversion works on. the arrays are carved from a
+// single arena sized from the collada count attributes, so nothing
+// grows or moves once the parse is done.
+struct Mesh {
+  arena mem;
+  vect *nodes;
+  int node_count;
+  int node_cap;
+  unsigned int *tridx;      // three node indices per triangle
+  triangle *triangles;      // the same triangles, by position
+  int tri_count;
+  int tri_cap;
+  edge *edges;              // every triangle edge, sorted by end points
+  int edge_count;
+  edge *beams;
+  int beam_count;
+  int beam_cap;
+  unsigned int *collision;  // three node indices per collision triangle
+  int collision_count;
+  unsigned int *scratch;    // beam_cap of working space for the passes
+  FILE *spill;              // sorted beams kept on disk instead, if any
+  int spill_count;
+  int *groups;              // first node of each separately written group
+  int group_count;          // 0 when the nodes are written as one group
+  int verbosity;            // the converter's, for the passes that log
+  tracer *trace;            // and its tracer, for the passes that time
+  std::string source;       // the file this came from, for the trace
+  unsigned long long geometry;  // hash of the node and index text
+  bool unchanged;           // the same geometry as the last conversion
+  std::vector <unsigned int> ids;  // the id each node is written with,
+                                   // or empty for its index
+
+  Mesh() {
+    nodes = NULL; node_count = 0; node_cap = 0;
+    tridx = NULL; triangles = NULL; tri_count = 0; tri_cap = 0;
+    edges = NULL; edge_count = 0;
+    beams = NULL; beam_count = 0; beam_cap = 0;
+    collision = NULL; collision_count = 0;
+    scratch = NULL;
+    spill = NULL; spill_count = 0;
+    groups = NULL; group_count = 0;
+    verbosity = LOG_NORMAL;
+    trace = NULL;
+    geometry = 0;
+    unchanged = false;
+  }
+  ~Mesh() { if (spill) fclose (spill); }
+  bool reserve(int max_nodes, int max_tris);
+};
+
+// threads that share out the tasks of a batch, down to the pieces of a
+// single file; see libsketcher.cpp
+struct taskPool;
+
+// the ids one jbeam gave its nodes, sorted by position
+typedef std::vector <std::pair <vect, unsigned int> > nodeIds;
+
+// what one conversion of a file leaves for the next, so that a file
+// converted again can skip the work that would come out the same and
+// keep the node ids other files refer to
+struct convertState {
+  unsigned long long geometry;  // of the last successful conversion, or 0
+  std::vector <nodeIds> ids;    // per jbeam written, largest lod first
+
+  // with reuse, the position and index text last parsed, the numbers
+  // they split into and how the points were welded, so that the next
+  // parse only tokenizes the part of a text that differs and only welds
+  // the points after the first that moved. kept in memory only, for a
+  // process that converts the same file over and over.
+  bool reuse;
+  std::string node_text;
+  std::vector <double> node_dims;
+  std::vector <unsigned int> remap;
+  std::map <vect, unsigned int> welded;
+  std::string tri_text;
+  std::vector <unsigned int> tri_points;
+
+  // the triangles the beams were last found from, with the pairs of
+  // co-planar ones that give the cross beams, so that only the pairs
+  // around the triangles that changed are looked for again. these go
+  // in the state file with the ids.
+  std::vector <triangle> triangles;
+  std::vector <std::pair <unsigned int, unsigned int> > near;
+
+  convertState() : geometry (0), reuse (false) {}
+
+  // the ids, triangles and pairs, in a binary file for the next run.
+  // a run with other options still converts.
+  bool load(const char *path);
+  bool save(const char *path) const;
+};
+
+// the settings for a conversion. the defaults give the same jbeam the
+// tool always wrote; the pipeline options are all off. a converter is
+// only read during a conversion, so one can drive several at once.
+struct Converter {
+  // node, beam and steering properties written to the jbeam
+  unsigned int node_weight;
+  double coef_friction;
+  unsigned int spring;
+  unsigned int damp;
+  unsigned int deform;
+  unsigned int strength;
+  double wheel_factor;
+  unsigned int wheel_lock;
+  unsigned int wheel_degrees;
+
+  // creases sharper than this are kept by the decimation
+  double crease_degrees;
+
+  std::string order;                // "", "morton" or "rcm"
+  int max_nodes;                    // decimate to this many nodes, 0 is off
+  std::vector <unsigned int> lods;  // node budgets, one jbeam each
+  double margin;                    // prune beams, -1 is off
+  int collision;                    // collision triangle budget, -1 is off
+  int mem_limit;                    // megabytes for on-disk beam sorts, 0 is off
+  bool pipeline;                    // overlap the on-disk stages on threads
+  int split;                        // threads for separate surfaces, 0 is one
+                                    // per processor, -1 is off
+  int max_triangles;                // refuse larger inputs, 0 is no limit
+  int verbosity;                    // LOG_QUIET up to LOG_TRACE
+  tracer *trace;                    // where to time the stages, if anywhere
+  taskPool *pool;                   // where to run the pieces of a stage side
+                                    // by side, if anywhere; set by batch
+  convertState *state;              // the last conversion of the same file,
+                                    // kept between runs by --watch and
+                                    // --keep-ids
+
+  Converter();
+
+  // true if the options can be used together
+  bool valid() const;
+
+  // read the nodes and triangles of a collada file, weld them and
+  // decimate to max_nodes. with mem_limit the beams are found here
+  // too, from the index text.
+  int parse(const char *fname, Mesh &mesh) const;
+  // the same from a collada document already in memory
+  int parseBuffer(const char *xml, size_t len, Mesh &mesh) const;
+
+  // the collision triangles and beams of a parsed mesh, pruned and
+  // renumbered as set. with split each surface is done on its own and
+  // becomes its own node group.
+  int extract(Mesh &mesh) const;
+
+  // write the jbeam, info and material files into dir, which must
+  // exist, or the current directory if dir is empty
+  int write(const Mesh &mesh, const std::string &dir,
+            const std::string &author, const std::string &model) const;
+  // only the jbeam, to an open stream
+  int writeJBeam(const Mesh &mesh, FILE *fp,
+                 const std::string &author, const std::string &model) const;
+
+  // check a parsed mesh for non-manifold edges, flipped neighbours,
+  // t junctions, boundary loops and stray nodes, and write what was
+  // found to a json report
+  int validate(Mesh &mesh, const std::string &report) const;
+
+  // all of the above for one file, with any lods in subdirectories
+  int convert(const char *fname, const std::string &dir,
+              const std::string &author, const std::string &model) const;
+
+  // convert each file into dir/<name>/, where name is the file's own
+  // without the extension, on up to jobs threads or one per processor
+  // for 0. the status of the first file that failed, if any did.
+  int batch(const std::vector <std::string> &files, const std::string &dir,
+            const std::string &author, int jobs) const;
+
+  // convert generated grids of doubling size with these options and
+  // fit how the time, and the heap where it is counted, grow with the
+  // triangles. SKETCHER_SCALING if either grows faster than n^exponent.
+  int scaling(double exponent) const;
+};
+
+// split a delimited list of unsigned numbers
+std::vector <unsigned int> UintSplit (std::string str, const char *delim);
+
+// compare the jbeam, info and material files written into dir with
+// those in expected, byte for byte. SKETCHER_MISMATCH names the first
+// line that differs.
+int compareExport (const std::string &dir, const std::string &expected,
+                   const std::string &model, int verbosity);
+
+#endif
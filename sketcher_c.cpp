@@ -0,0 +1,153 @@
+/*
+ * (c) 2017 the mullican group
+ * kevin mullican
+ *
+ * sketcher_c.cpp
+ *
+ * the c interface in sketcher_c.h, on top of Converter
+ */
+
+#include <new>
+#include <algorithm>
+#include <string>
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sketcher.h"
+
+using namespace std;
+
+struct sketcher {
+  Converter conv;
+  sketcher_stats stats;
+};
+
+sketcher *sketcher_open (void) {
+  sketcher *s = new (nothrow) sketcher;
+  if (! s) return NULL;
+  s -> conv.verbosity = LOG_QUIET;
+  memset (&s -> stats, 0, sizeof (s -> stats));
+  return s;
+}
+
+int sketcher_set_option (sketcher *s, const char *name, const char *value) {
+  if (! s || ! name || ! value) return SKETCHER_USAGE;
+
+  Converter &conv = s -> conv;
+  try {
+    if (! strcmp ("order", name))
+      conv.order = value;
+    else if (! strcmp ("max-nodes", name))
+      conv.max_nodes = atoi (value);
+    else if (! strcmp ("prune", name))
+      conv.margin = atof (value);
+    else if (! strcmp ("collision", name))
+      conv.collision = atoi (value);
+    else if (! strcmp ("mem-limit", name))
+      conv.mem_limit = atoi (value);
+    else if (! strcmp ("split", name))
+      conv.split = atoi (value);
+    else if (! strcmp ("max-triangles", name))
+      conv.max_triangles = atoi (value);
+    else if (! strcmp ("pipeline", name))
+      conv.pipeline = atoi (value) != 0;
+    else if (! strcmp ("verbosity", name))
+      conv.verbosity = atoi (value);
+    else
+      return SKETCHER_USAGE;
+  } catch (const bad_alloc &) {
+    return SKETCHER_NO_MEMORY;
+  }
+  return SKETCHER_OK;
+}
+
+static int convertBuffer (sketcher *s, const char *xml, size_t len,
+                          const char *author, const char *model,
+                          char *out, size_t out_cap, size_t *out_len) {
+  const Converter &conv = s -> conv;
+
+  // nothing may unwind into a c caller
+  try {
+    Mesh mesh;
+    double start = tracer::now ();
+    int err = conv . parseBuffer (xml, len, mesh);
+    if (err) return err;
+    double parsed = tracer::now ();
+    err = conv . extract (mesh);
+    if (err) return err;
+    double extracted = tracer::now ();
+
+    char *text = NULL;
+    size_t size = 0;
+    FILE *fp = open_memstream (&text, &size);
+    if (! fp) return SKETCHER_NO_MEMORY;
+    err = conv . writeJBeam (mesh, fp, author, model);
+    fclose (fp);
+    double written = tracer::now ();
+    if (err) {
+      free (text);
+      return err;
+    }
+
+    *out_len = size;
+    if (size > out_cap || (size && ! out)) {
+      free (text);
+      return SKETCHER_TOO_SMALL;
+    }
+    memcpy (out, text, size);
+    free (text);
+
+    s -> stats.nodes = mesh.node_count;
+    s -> stats.triangles = mesh.tri_count;
+    s -> stats.beams = mesh.spill ? mesh.spill_count : mesh.beam_count;
+    s -> stats.collision_triangles = mesh.collision_count;
+    s -> stats.jbeam_bytes = size;
+    s -> stats.parse_ms = (parsed - start) / 1e3;
+    s -> stats.extract_ms = (extracted - parsed) / 1e3;
+    s -> stats.write_ms = (written - extracted) / 1e3;
+  } catch (const bad_alloc &) {
+    return SKETCHER_NO_MEMORY;
+  }
+  return SKETCHER_OK;
+}
+
+int sketcher_convert_buffer (sketcher *s, const char *xml, size_t len,
+                             const char *author, const char *model,
+                             char *out, size_t out_cap, size_t *out_len) {
+  if (! s || ! xml || ! author || ! model || ! out_len) return SKETCHER_USAGE;
+  *out_len = 0;
+  if (! s -> conv . valid ()) return SKETCHER_USAGE;
+
+  // the peak is measured from here, then folded back into the caller's
+  size_t outer_peak = memoryStats::markPeak ();
+  memoryStats before = memoryStats::now ();
+  int err = convertBuffer (s, xml, len, author, model, out, out_cap, out_len);
+  memoryStats after = memoryStats::now ();
+  memoryStats::restorePeak (outer_peak);
+  if (err) return err;
+
+  s -> stats.allocations = after.allocations - before.allocations;
+  s -> stats.allocated_bytes = after.bytes - before.bytes;
+  s -> stats.peak_heap_bytes = after.peak - before.live;
+  s -> stats.peak_rss_kb = after.max_rss_kb;
+  return SKETCHER_OK;
+}
+
+// callers built against an older header have a shorter struct, so
+// never write more than they have room for
+int sketcher_get_stats (const sketcher *s, sketcher_stats *stats) {
+  return sketcher_get_stats_sized (s, stats, offsetof (sketcher_stats, allocations));
+}
+
+int sketcher_get_stats_sized (const sketcher *s, sketcher_stats *stats, size_t size) {
+  if (! s || ! stats) return SKETCHER_USAGE;
+  memcpy (stats, &s -> stats, min (size, sizeof (sketcher_stats)));
+  return SKETCHER_OK;
+}
+
+void sketcher_free (sketcher *s) {
+  delete s;
+}
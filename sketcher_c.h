@@ -0,0 +1,104 @@
+/*
+ * (c) 2017 the mullican group
+ * kevin mullican
+ *
+ * sketcher_c.h
+ *
+ * c interface to libsketcher, for converting collada documents held in
+ * memory from a long running process. the functions and structures here
+ * only ever grow at the end, so programs built against an older copy keep
+ * working.
+ */
+
+#ifndef SKETCHER_C_H
+#define SKETCHER_C_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SKETCHER_API_VERSION 3
+
+// what a conversion stage returns. the command line tool exits with
+// these, so the numbers stay put.
+enum {
+  SKETCHER_OK = 0,
+  SKETCHER_USAGE = 1,
+  SKETCHER_UNREADABLE = 2,
+  SKETCHER_BAD_XML = 3,
+  SKETCHER_NO_COLLADA = 4,
+  SKETCHER_NO_MESH = 5,
+  SKETCHER_NO_NODES = 6,
+  SKETCHER_NO_TRIANGLES = 7,
+  SKETCHER_NO_INDICES = 8,
+  SKETCHER_NO_MEMORY = 9,
+  SKETCHER_SPILL = 10,
+  SKETCHER_EXPORT = 11,
+  SKETCHER_TOO_SMALL = 12,
+  SKETCHER_SCALING = 13,
+  SKETCHER_MISMATCH = 14,
+  SKETCHER_TOO_LARGE = 15
+};
+
+// a converter and what its last conversion produced. one handle is
+// used by one thread at a time; separate handles run side by side.
+typedef struct sketcher sketcher;
+
+// counts from the last successful conversion on a handle. fields are
+// only added at the end, so a program sees the ones it was built with.
+typedef struct sketcher_stats {
+  unsigned int nodes;
+  unsigned int triangles;
+  unsigned int beams;
+  unsigned int collision_triangles;
+  size_t jbeam_bytes;
+  // since version 2: heap use of the conversion, only counted by a
+  // library built with MEMSTATS=1; zero otherwise. peak_rss_kb is for
+  // the whole process.
+  unsigned long allocations;
+  size_t allocated_bytes;
+  size_t peak_heap_bytes;
+  long peak_rss_kb;
+  // since version 3: how long each part took, to spot the inputs that
+  // are slow to convert
+  double parse_ms;
+  double extract_ms;
+  double write_ms;
+} sketcher_stats;
+
+// a handle with the default jbeam properties and no options set, or
+// NULL if out of memory. it prints nothing but errors until the
+// verbosity is raised.
+sketcher *sketcher_open (void);
+
+// set an option by its command line name, without the dashes:
+// "order", "max-nodes", "prune", "collision", "mem-limit", "split",
+// "max-triangles" or "pipeline" (1 or 0), or "verbosity" from 0 for
+// errors only up to 3 for every beam. max-triangles is worth setting
+// for untrusted documents.
+int sketcher_set_option (sketcher *s, const char *name, const char *value);
+
+// convert the collada document in xml[0..len) and write the jbeam into
+// out[0..out_cap). *out_len gets the jbeam length, which is also set when
+// SKETCHER_TOO_SMALL says out_cap was not enough. the jbeam is not null
+// terminated.
+int sketcher_convert_buffer (sketcher *s, const char *xml, size_t len,
+                             const char *author, const char *model,
+                             char *out, size_t out_cap, size_t *out_len);
+
+// the fields up to jbeam_bytes, all that version 1 had
+int sketcher_get_stats (const sketcher *s, sketcher_stats *stats);
+
+// every field that fits in size bytes of stats, which should be
+// sizeof (sketcher_stats) where the caller was built
+int sketcher_get_stats_sized (const sketcher *s, sketcher_stats *stats, size_t size);
+
+void sketcher_free (sketcher *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,96 @@
+#!/bin/sh
+#
+# checks for the sketcher tool, run by make check from the top of the
+# tree. usage: tests/check.sh <sketcher binary> [--record]
+#
+# with --record the goldens and times of the corpus are written afresh
+# from the binary given, for when a change to the output is intended.
+
+sketcher=${1:-./sketcher}
+record=0
+[ "$2" = --record ] && record=1
+case $sketcher in /*) ;; *) sketcher=$PWD/$sketcher ;; esac
+tests=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+failed=0
+
+fail () {
+  echo "FAIL: $*"
+  failed=1
+}
+
+# the node lines of a jbeam, then its body beams with the lower id
+# first, sorted, since the in-memory and on-disk paths differ in order
+shape () {
+  grep -E '^ +\["b[0-9]+",-?[0-9]' "$1"
+  grep -E '^ +\["b[0-9]+","b[0-9]+"\],$' "$1" |
+    sed 's/[^0-9,]//g' |
+    awk -F, '{ if ($1 + 0 > $2 + 0) print $2, $1; else print $1, $2 }' |
+    sort -n
+}
+
+# convert <dir> <input> [options], quietly, into $work/<dir>/m
+convert () {
+  dir=$work/$1
+  input=$2
+  shift 2
+  mkdir -p "$dir"
+  (cd "$dir" && "$sketcher" -q -f "$input" -m m -n tests "$@")
+}
+
+# the on-disk path has to clean triangles the way the in-memory one does
+for input in "$tests/dirty.dae"; do
+  name=$(basename "$input" .dae)
+  convert "$name.mem" "$input" || fail "$name: in memory exited $?"
+  convert "$name.disk" "$input" --mem-limit 1 || fail "$name: --mem-limit exited $?"
+  convert "$name.pipe" "$input" --mem-limit 1 --pipeline || fail "$name: --pipeline exited $?"
+  shape "$work/$name.mem/m/m.jbeam" > "$work/$name.mem.shape"
+  for path in disk pipe; do
+    shape "$work/$name.$path/m/m.jbeam" > "$work/$name.$path.shape"
+    cmp -s "$work/$name.mem.shape" "$work/$name.$path.shape" ||
+      fail "$name: $path beams differ from in memory"
+  done
+done
+
+# the golden corpus: each case in tests/cases is converted with --expect
+# against its files in golden/<name>/, and may take no more than
+# TIME_FACTOR times its time in golden/times plus TIME_SLACK ms
+golden=$tests/golden
+factor=${TIME_FACTOR:-3}
+slack=${TIME_SLACK:-50}
+: > "$work/times"
+while read name input options; do
+  case $name in ''|'#'*) continue ;; esac
+
+  if [ $record = 1 ]; then
+    rm -rf "$golden/$name"
+    (cd "$golden" && "$sketcher" -q -f "$tests/$input" -m "$name" -n tests $options) ||
+      fail "$name: exited $? while recording"
+  fi
+
+  # the tool times the conversion itself, leaving out the comparison
+  dir=$work/case.$name
+  mkdir -p "$dir"
+  if ! (cd "$dir" && "$sketcher" -f "$tests/$input" -m "$name" -n tests $options \
+          --expect "$golden/$name") > "$dir.log" 2>&1; then
+    fail "$name: differs from golden/$name"
+    tail -n 3 "$dir.log"
+    continue
+  fi
+  took=$(sed -n 's/^converted .* in \([0-9.]*\) ms$/\1/p' "$dir.log")
+  echo "$name $took" | awk '{ printf "%s %d\n", $1, $2 + 0.999 }' >> "$work/times"
+  [ $record = 1 ] && continue
+
+  want=$(awk -v name="$name" '$1 == name { print $2 }' "$golden/times")
+  if [ -z "$want" ]; then
+    fail "$name: no time in golden/times"
+  elif ! awk -v took="$took" -v want="$want" -v f="$factor" -v s="$slack" \
+             'BEGIN { exit ! (took <= want * f + s) }'; then
+    fail "$name: took $took ms, more than $factor x $want + $slack ms"
+  fi
+done < "$tests/cases"
+
+[ $record = 1 ] && [ $failed = 0 ] && cp "$work/times" "$golden/times"
+[ $failed = 0 ] && echo "all checks passed"
+exit $failed
@@ -0,0 +1,83 @@
+/*
+ * (c) 2017 the mullican group
+ * kevin mullican
+ *
+ * fuzz.cpp
+ *
+ * libFuzzer harness for the collada reader, through the c interface
+ * that converts documents held in memory: the element search, the
+ * number splitting, welding and beam extraction all see each input.
+ * besides crashes, an input is reported when it converts slower than
+ * a linear time budget for its size, so absurd counts, long tokens,
+ * deep nesting and edge fans show up as findings rather than as a
+ * slow worker in production. huge allocations are caught by libFuzzer
+ * itself, with -malloc_limit_mb and -rss_limit_mb.
+ *
+ * make fuzz builds it with clang; built with SKETCHER_FUZZ_MAIN by
+ * any compiler, it replays the files given instead, e.g. a crash.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sketcher.h"
+
+// the time an input may take: a fixed part for the tool itself and
+// a part per byte, both far above what a linear conversion needs
+#define BUDGET_MS 200.0
+#define BUDGET_MS_PER_KB 2.0
+
+// a jbeam for the largest inputs the fuzzer makes
+#define OUT_CAP (16 << 20)
+
+static sketcher *handle () {
+  static sketcher *s = NULL;
+  if (! s) {
+    s = sketcher_open ();
+    if (! s) abort ();
+    // the limit a service taking uploads would set
+    sketcher_set_option (s, "max-triangles", "1000000");
+  }
+  return s;
+}
+
+extern "C" int LLVMFuzzerTestOneInput (const uint8_t *data, size_t size) {
+  static char *out = (char *)malloc (OUT_CAP);
+  if (! out) abort ();
+
+  size_t out_len;
+  double start = tracer::now ();
+  sketcher_convert_buffer (handle (), (const char *)data, size, "fuzz", "fuzz",
+                           out, OUT_CAP, &out_len);
+  double took = (tracer::now () - start) / 1e3;
+
+  double budget = BUDGET_MS + BUDGET_MS_PER_KB * size / 1024;
+  if (took > budget) {
+    fprintf (stderr, "%zu bytes took %.1f ms, over the %.1f ms budget\n", size, took, budget);
+    abort ();
+  }
+  return 0;
+}
+
+#ifdef SKETCHER_FUZZ_MAIN
+int main (int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    FILE *fp = fopen (argv[i], "rb");
+    if (! fp) {
+      printf ("unable to read: %s\n", argv[i]);
+      return SKETCHER_UNREADABLE;
+    }
+    fseek (fp, 0, SEEK_END);
+    long len = ftell (fp);
+    rewind (fp);
+    char *data = (char *)malloc (len > 0 ? len : 1);
+    size_t got = fread (data, 1, len > 0 ? len : 0, fp);
+    fclose (fp);
+    LLVMFuzzerTestOneInput ((const uint8_t *)data, got);
+    free (data);
+    printf ("%s: ok\n", argv[i]);
+  }
+  return 0;
+}
+#endif
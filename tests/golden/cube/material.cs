@@ -0,0 +1,23 @@
+singleton Material(cube_body)
+{
+    mapTo = "cube_body";
+    diffuseMap[0] = "cube_body.png";
+    specularPower[0] = "15";
+    useAnisotropic[0] = "1";
+    castShadows = "1";
+    translucent = "0";
+    alphaTest = "0";
+    alphaRef = "0";
+}
+
+singleton Material(cube_wheel)
+{
+    mapTo = "cube_wheel";
+    diffuseMap[0] = "cube_wheel.png";
+    specularPower[0] = "15";
+    useAnisotropic[0] = "1";
+    castShadows = "1";
+    translucent = "0";
+    alphaTest = "0";
+    alphaRef = "0";
+}
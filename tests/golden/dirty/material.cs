@@ -0,0 +1,23 @@
+singleton Material(dirty_body)
+{
+    mapTo = "dirty_body";
+    diffuseMap[0] = "dirty_body.png";
+    specularPower[0] = "15";
+    useAnisotropic[0] = "1";
+    castShadows = "1";
+    translucent = "0";
+    alphaTest = "0";
+    alphaRef = "0";
+}
+
+singleton Material(dirty_wheel)
+{
+    mapTo = "dirty_wheel";
+    diffuseMap[0] = "dirty_wheel.png";
+    specularPower[0] = "15";
+    useAnisotropic[0] = "1";
+    castShadows = "1";
+    translucent = "0";
+    alphaTest = "0";
+    alphaRef = "0";
+}
@@ -0,0 +1,23 @@
+singleton Material(group_cube_body)
+{
+    mapTo = "group_cube_body";
+    diffuseMap[0] = "group_cube_body.png";
+    specularPower[0] = "15";
+    useAnisotropic[0] = "1";
+    castShadows = "1";
+    translucent = "0";
+    alphaTest = "0";
+    alphaRef = "0";
+}
+
+singleton Material(group_cube_wheel)
+{
+    mapTo = "group_cube_wheel";
+    diffuseMap[0] = "group_cube_wheel.png";
+    specularPower[0] = "15";
+    useAnisotropic[0] = "1";
+    castShadows = "1";
+    translucent = "0";
+    alphaTest = "0";
+    alphaRef = "0";
+}
@@ -0,0 +1,23 @@
+singleton Material(instanced_body)
+{
+    mapTo = "instanced_body";
+    diffuseMap[0] = "instanced_body.png";
+    specularPower[0] = "15";
+    useAnisotropic[0] = "1";
+    castShadows = "1";
+    translucent = "0";
+    alphaTest = "0";
+    alphaRef = "0";
+}
+
+singleton Material(instanced_wheel)
+{
+    mapTo = "instanced_wheel";
+    diffuseMap[0] = "instanced_wheel.png";
+    specularPower[0] = "15";
+    useAnisotropic[0] = "1";
+    castShadows = "1";
+    translucent = "0";
+    alphaTest = "0";
+    alphaRef = "0";
+}
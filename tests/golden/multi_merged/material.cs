@@ -0,0 +1,23 @@
+singleton Material(multi_merged_body)
+{
+    mapTo = "multi_merged_body";
+    diffuseMap[0] = "multi_merged_body.png";
+    specularPower[0] = "15";
+    useAnisotropic[0] = "1";
+    castShadows = "1";
+    translucent = "0";
+    alphaTest = "0";
+    alphaRef = "0";
+}
+
+singleton Material(multi_merged_wheel)
+{
+    mapTo = "multi_merged_wheel";
+    diffuseMap[0] = "multi_merged_wheel.png";
+    specularPower[0] = "15";
+    useAnisotropic[0] = "1";
+    castShadows = "1";
+    translucent = "0";
+    alphaTest = "0";
+    alphaRef = "0";
+}
@@ -0,0 +1,23 @@
+singleton Material(pyramid_body)
+{
+    mapTo = "pyramid_body";
+    diffuseMap[0] = "pyramid_body.png";
+    specularPower[0] = "15";
+    useAnisotropic[0] = "1";
+    castShadows = "1";
+    translucent = "0";
+    alphaTest = "0";
+    alphaRef = "0";
+}
+
+singleton Material(pyramid_wheel)
+{
+    mapTo = "pyramid_wheel";
+    diffuseMap[0] = "pyramid_wheel.png";
+    specularPower[0] = "15";
+    useAnisotropic[0] = "1";
+    castShadows = "1";
+    translucent = "0";
+    alphaTest = "0";
+    alphaRef = "0";
+}
@@ -0,0 +1,23 @@
+singleton Material(textured_body)
+{
+    mapTo = "textured_body";
+    diffuseMap[0] = "textured_body.png";
+    specularPower[0] = "15";
+    useAnisotropic[0] = "1";
+    castShadows = "1";
+    translucent = "0";
+    alphaTest = "0";
+    alphaRef = "0";
+}
+
+singleton Material(textured_wheel)
+{
+    mapTo = "textured_wheel";
+    diffuseMap[0] = "textured_wheel.png";
+    specularPower[0] = "15";
+    useAnisotropic[0] = "1";
+    castShadows = "1";
+    translucent = "0";
+    alphaTest = "0";
+    alphaRef = "0";
+}